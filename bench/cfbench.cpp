@@ -0,0 +1,84 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <cubestate.h>
+#include <cube_moves.h>
+#include <orbitkernels.h>
+#include <commutatorfinder.h>
+
+#include "easylogging++.h"
+INITIALIZE_EASYLOGGINGPP
+
+// @returns nanoseconds per call of @param f(i), i = 0..numCalls-1
+static double nsPerCall(uint64_t numCalls, const std::function<void(uint64_t)>& f) {
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < numCalls; ++i)
+        f(i);
+    const std::chrono::duration<double, std::nano> elapsed
+            = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / numCalls;
+}
+
+static void report(const std::string& name, double ns) {
+    std::cout << std::left << std::setw(40) << name << std::fixed << std::setprecision(2)
+              << ns << " ns" << std::endl;
+}
+
+// applyScrambleMove, and hash() which is computed from the stickers on each call
+static void benchMoveHash() {
+    constexpr uint64_t kNumMoves = 20'000'000;
+    // moves in a pseudo-random order so that no two consecutive ones cancel out
+    auto move = [](uint64_t i) { return uint8_t(i * 7 % kNumAllQtmMoves); };
+    CubeState cube;
+    const double nsMove = nsPerCall(kNumMoves, [&](uint64_t i) {
+        cube.applyScrambleMove(move(i));
+    });
+    uint64_t hashes = 0;
+    const double nsMoveAndHash = nsPerCall(kNumMoves, [&](uint64_t i) {
+        cube.applyScrambleMove(move(i));
+        hashes ^= cube.hash();
+    });
+    // keep the hashes alive
+    if (0 == hashes)
+        std::cerr << "hashes cancel out" << std::endl;
+    report("applyScrambleMove", nsMove);
+    report("applyScrambleMove + hash()", nsMoveAndHash);
+    report("hash() per move", nsMoveAndHash - nsMove);
+}
+
+// CommutatorFinder::find with 1, 2, 4... threads up to the number of cores
+static void benchParallelFind(uint8_t maxMovesPartB) {
+    SearchCriteria criteria(true, CenterSafety::SolvedCenterSafe);
+    criteria.set(CaseType::allSolved, false);
+    CommutatorFinder cf(maxMovesPartB, criteria, "/tmp/cfbench_comms.txt");
+    const unsigned numCores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> threadCounts;
+    for (unsigned numThreads = 1; numThreads < numCores; numThreads *= 2)
+        threadCounts.push_back(numThreads);
+    threadCounts.push_back(numCores);
+    double singleThreaded = 0;
+    for (unsigned numThreads: threadCounts) {
+        cf.setNumThreads(numThreads);
+        const double ns = nsPerCall(1, [&](uint64_t) { cf.find(); });
+        if (1 == numThreads)
+            singleThreaded = ns;
+        report("find " + std::to_string(maxMovesPartB) + "-move partB, "
+               + std::to_string(numThreads) + " threads, x" + std::to_string(singleThreaded / ns)
+               , ns);
+    }
+}
+
+/// usage: cfBench [max_moves]
+/// max_moves - partB length for the find benchmark, 3 by default. Use 5 to time thread
+/// scaling on a search long enough to balance the subtrees
+int main(int argc, char** argv) {
+    std::cout << "move kernel: " << bestOrbitKernel().name << std::endl;
+    benchMoveHash();
+    benchParallelFind(argc > 1 ? std::stoi(argv[1]) : 3);
+    return 0;
+}
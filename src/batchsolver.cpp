@@ -0,0 +1,112 @@
+#include "batchsolver.h"
+#include "resultformat.h"
+#include "workstealingqueues.h"
+#include <easylogging++.h>
+#include <algorithm>
+#include <atomic>
+#include <istream>
+#include <ostream>
+#include <thread>
+
+BatchSolver::BatchSolver(const PatternDatabases* databases):
+    databases_(databases)
+{
+}
+
+size_t BatchSolver::add(const CubeState& state) {
+    std::vector<size_t>& ids = idsByHash_[state.hash()];
+    for (size_t id: ids)
+        if (states_[id] == state)
+            return id;
+    ids.push_back(states_.size());
+    states_.push_back(state);
+    return ids.back();
+}
+
+void BatchSolver::solve() {
+    const size_t first = solutions_.size();
+    solutions_.resize(states_.size());
+    solved_.resize(states_.size(), false);
+
+    // states are solved one per thread: no splitting overhead, so throughput is the best
+    WorkStealingQueues<size_t> queues(numThreads_);
+    for (size_t id = first; id < states_.size(); ++id)
+        queues.push(id % numThreads_, id);
+    std::atomic<size_t> numDone = 0;
+    auto work = [&](unsigned worker) {
+        for (size_t id; queues.pop(worker, id);) {
+            if (states_[id].isSolved()) {
+                solved_[id] = true;
+            } else {
+                BruteForceSolver solver(states_[id]);
+                solver.setStrategy(SolverStrategy::IdaStar);
+                solver.setPatternDatabases(databases_);
+                solver.setAllowedMoves(allowedMoves_);
+                solver.setVerbose(false);
+                solutions_[id] = solver.solveSequence(maxSolutionLength_);
+                solved_[id] = !solutions_[id].empty();
+            }
+            const size_t done = ++numDone;
+            LOG_IF(0 == done % 1000, INFO) << "solved " << done << " of "
+                                           << states_.size() - first << " states";
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < numThreads_; ++i)
+        threads.emplace_back(work, i);
+    work(0);
+    for (auto& thread: threads)
+        thread.join();
+}
+
+void BatchSolver::clear() {
+    states_.clear();
+    idsByHash_.clear();
+    solutions_.clear();
+    solved_.clear();
+}
+
+AnnotationCounts annotateResults(std::istream& in, std::ostream& out, BatchSolver& solver
+                                 , size_t chunkSize) {
+    // results of a chunk are solved at once, so its lines are kept until then
+    AnnotationCounts counts;
+    std::vector<std::string> lines;
+    std::vector<size_t> ids;
+    constexpr size_t kNotResult = SIZE_MAX;
+    const auto annotateChunk = [&] {
+        LOG(INFO) << "solving " << solver.numStates() << " unique states of "
+                  << ids.size() - std::count(ids.begin(), ids.end(), kNotResult) << " results";
+        solver.solve();
+        for (size_t i = 0; i < lines.size(); ++i) {
+            out << lines[i];
+            if (kNotResult != ids[i]) {
+                if (solver.isSolved(ids[i])) {
+                    out << " (optimal " << solver.solution(ids[i]).size() << ")";
+                } else {
+                    out << " (not found within " << int(solver.maxSolutionLength()) << ")";
+                    ++counts.numNotFound;
+                }
+                ++counts.numResults;
+            }
+            out << "\n";
+        }
+        lines.clear();
+        ids.clear();
+        solver.clear();
+    };
+    ResultRecord record;
+    std::string cycles;
+    for (std::string line; std::getline(in, line);) {
+        if (parseResultLine(line, record, cycles)) {
+            ids.push_back(solver.add(commutator(CubeState::moveState(record.partA)
+                                                , CubeState().applyScramble(record.partB))));
+        } else {
+            ids.push_back(kNotResult);
+        }
+        lines.push_back(std::move(line));
+        if (lines.size() >= chunkSize)
+            annotateChunk();
+    }
+    annotateChunk();
+    return counts;
+}
@@ -0,0 +1,78 @@
+#ifndef BATCHSOLVER_H
+#define BATCHSOLVER_H
+#include "bruteforcesolver.h"
+#include "cubestate.h"
+
+#include <algorithm>
+#include <iosfwd>
+#include <unordered_map>
+#include <vector>
+
+class PatternDatabases;
+
+// default longest solution searched by BatchSolver. Every extra move takes ~17x more time for
+// states without a solution that short; with the default pattern databases, such a state
+// takes ~3 s at 7 moves on one core
+constexpr uint8_t kDefaultMaxSolutionLength = 7;
+
+// results annotated at once by annotateResults: their lines and unique states are in memory
+constexpr size_t kAnnotateChunkSize = 1 << 16;
+
+// Solves many states for throughput: identical states are solved once, unique states are
+// solved concurrently (one single-threaded BruteForceSolver per state), all of them sharing
+// the same pattern databases
+class BatchSolver {
+public:
+    /// @param databases - heuristic of the IdaStar solvers, not owned; may be nullptr
+    explicit BatchSolver(const PatternDatabases* databases = nullptr);
+
+    void setNumThreads(unsigned numThreads) {numThreads_ = std::max(1u, numThreads);}
+    void setMaxSolutionLength(uint8_t maxLength) {maxSolutionLength_ = maxLength;}
+    uint8_t maxSolutionLength() const {return maxSolutionLength_;}
+
+    /// solutions only use moves of @param allowedMoves, see BruteForceSolver::setAllowedMoves
+    void setAllowedMoves(const MoveSet& allowedMoves) {allowedMoves_ = allowedMoves;}
+
+    /// @returns id of the unique state equal to @param state; it's solved by the next solve()
+    size_t add(const CubeState& state);
+
+    /// @returns number of unique states added so far
+    size_t numStates() const {return states_.size();}
+
+    /// solves all states added since the last call
+    void solve();
+
+    /// forgets all states and solutions, ids start from 0 again
+    void clear();
+
+    /// @returns true if state #@param id has a solution within maxSolutionLength()
+    bool isSolved(size_t id) const {return solved_[id];}
+
+    /// @returns optimal solution of state #@param id, empty for solved or unsolvable states
+    const MoveSequence& solution(size_t id) const {return solutions_[id];}
+
+private:
+    const PatternDatabases* databases_;
+    unsigned numThreads_ = 1;
+    uint8_t maxSolutionLength_ = kDefaultMaxSolutionLength;
+    MoveSet allowedMoves_ = allMoves();
+    std::vector<CubeState> states_;
+    std::unordered_map<uint64_t, std::vector<size_t>> idsByHash_;
+    std::vector<MoveSequence> solutions_;
+    std::vector<uint8_t> solved_; // not vector<bool>: threads set neighbouring items
+};
+
+struct AnnotationCounts {
+    uint64_t numResults = 0;  // annotated results
+    uint64_t numNotFound = 0; // results without a solution within solver.maxSolutionLength()
+};
+
+/// copies lines of @param in to @param out, commutator results "cycles[*]: [A, B][ (inert)]"
+/// are followed by " (optimal N)", where N is the optimal length of the commutator state, or
+/// " (not found within M)" if it's longer than M = solver.maxSolutionLength().
+/// Lines are read, solved and written in chunks of @param chunkSize, and the solver is cleared
+/// after each, so identical states are solved once per chunk
+AnnotationCounts annotateResults(std::istream& in, std::ostream& out, BatchSolver& solver
+                                 , size_t chunkSize = kAnnotateChunkSize);
+
+#endif // BATCHSOLVER_H
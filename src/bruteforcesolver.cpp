@@ -1,5 +1,10 @@
 #include "bruteforcesolver.h"
+#include "patterndatabase.h"
+#include "workstealingqueues.h"
 #include <easylogging++.h>
+#include <algorithm>
+#include <numeric>
+#include <thread>
 
 BruteForceSolver::BruteForceSolver(const CubeState &stateToSolve):
     initialState_(stateToSolve)
@@ -7,33 +12,386 @@ BruteForceSolver::BruteForceSolver(const CubeState &stateToSolve):
 }
 
 MovesArray BruteForceSolver::solve(uint8_t maxSolutionLength) {
-    static MovesArray none = emptyMovesArray();
+    MovesArray result = emptyMovesArray();
+    const MoveSequence solution = solveSequence(std::min(maxSolutionLength, kMaxScrambleLength));
+    std::copy(solution.begin(), solution.end(), result.begin());
+    return result;
+}
+
+MoveSequence BruteForceSolver::solveSequence(uint8_t maxSolutionLength) {
     if (initialState_.isSolved()) {
         LOG(WARNING) << "BruteForceSolver::solve but state is already solved, returning 0";
-        return none;
+        return {};
+    }
+    switch (strategy_) {
+    case SolverStrategy::IdaStar:
+        return solveIdaStar(maxSolutionLength);
+    case SolverStrategy::MeetInTheMiddle: {
+        const auto solutions = solveMeetInTheMiddle(maxSolutionLength, false);
+        return solutions.empty() ? MoveSequence() : solutions.front();
+    }
+    default:
+        return solveBreadthSweep(std::min(maxSolutionLength, kMaxScrambleLength));
     }
+}
 
-    bool isSolved = false;
+std::vector<MoveSequence> BruteForceSolver::solveAll(uint8_t maxSolutionLength) {
+    if (SolverStrategy::MeetInTheMiddle == strategy_ && !initialState_.isSolved())
+        return solveMeetInTheMiddle(maxSolutionLength, true);
+    MoveSequence solution = solveSequence(maxSolutionLength);
+    if (solution.empty())
+        return {};
+    return {solution};
+}
 
-    // TODO introduce parallelism
-    CubeState state = initialState_;
-    uint8_t currentDepth = 1;
-    // TODO measure time and report progress
-    while (currentDepth <= maxSolutionLength) {
-        state = initialState_; // TODO compare this with undoing moves
-        state.applyScramble(iterativeScramble_.get());
-        isSolved |= state.isSolved();
-        if (isSolved) {
-            LOG(INFO) << "found solution: " << iterativeScramble_.toString();
-            break;
+size_t BruteForceSolver::runTasks(size_t numTasks, const TaskFunction& run) const {
+    std::atomic<size_t> solvedTask = numTasks;
+    WorkStealingQueues<size_t> queues(numThreads_);
+    for (size_t i = 0; i < numTasks; ++i)
+        queues.push(i % numThreads_, i);
+    auto work = [&](unsigned worker) {
+        for (size_t task; queues.pop(worker, task);) {
+            if (solvedTask < task || !run(worker, task, solvedTask))
+                continue;
+            size_t solved = solvedTask;
+            while (task < solved && !solvedTask.compare_exchange_weak(solved, task)) {}
         }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < numThreads_ && i < numTasks; ++i)
+        threads.emplace_back(work, i);
+    work(0);
+    for (auto& thread: threads)
+        thread.join();
+    return solvedTask;
+}
+
+MoveSequence BruteForceSolver::solveBreadthSweep(uint8_t maxSolutionLength) {
+    // scrambles of the same size whose last move is m are one task: a contiguous range of ranks
+    std::vector<MovesArray> solutions(kNumAllQtmMoves);
+    for (uint8_t size = 1; size <= maxSolutionLength; ++size) {
+        LOG_IF(verbose_ && size > 2, INFO) << "searching depth " << int(size);
+        const auto sweep = [&](unsigned, size_t lastMove, const std::atomic<size_t>& solvedTask) {
+            const uint64_t begin = IncrementalScramble::count(size, kNoMove, lastMove);
+            const uint64_t end = IncrementalScramble::count(size, kNoMove, lastMove + 1);
+            if (begin == end || !allowedMoves_[lastMove])
+                return false;
+            IncrementalScramble scramble;
+            scramble.set(IncrementalScramble::unrank(size, begin));
+            for (uint64_t rank = begin; rank < end && scramble.size() == size;) {
+                if (solvedTask < lastMove)
+                    return false;
+                // skip all scrambles sharing the latest disallowed move and the moves after it
+                uint8_t disallowed = size;
+                while (disallowed > 0 && allowedMoves_[scramble.get()[disallowed - 1]])
+                    --disallowed;
+                if (0 != disallowed) {
+                    scramble.skipSubtree(disallowed - 1);
+                    rank = IncrementalScramble::rank(scramble.get());
+                    continue;
+                }
+                CubeState state = initialState_; // IdaStar undoes moves instead of replaying
+                state.applyScramble(scramble.get());
+                if (state.isSolved()) {
+                    solutions[lastMove] = scramble.get();
+                    return true;
+                }
+                ++rank;
+                ++scramble;
+            }
+            return false;
+        };
+        const size_t solved = runTasks(kNumAllQtmMoves, sweep);
+        if (solved < kNumAllQtmMoves) {
+            const MovesArray& moves = solutions[solved];
+            LOG_IF(verbose_, INFO) << "found solution: " << toString(moves);
+            return MoveSequence(moves.begin(), moves.begin() + numMoves(moves));
+        }
+    }
+    return {};
+}
+
+uint8_t BruteForceSolver::heuristic(const CubeState& state) const {
+    return (nullptr == databases_) ? 0 : databases_->heuristic(state);
+}
+
+MoveSequence BruteForceSolver::solveIdaStar(uint8_t maxSolutionLength) {
+    numVisitedStates_ = 0;
+    // subtrees of the parallel search: canonical prefixes of kSplitDepth moves in search order
+    std::vector<MoveSequence> prefixes;
+    if (numThreads_ > 1) {
+        for (uint8_t m1 = 0; m1 < kNumAllQtmMoves; ++m1)
+            for (uint8_t m2 = 0; m2 < kNumAllQtmMoves; ++m2)
+                if (allowedMoves_[m1] && allowedMoves_[m2] && canFollow(m1, m2))
+                    prefixes.push_back({m1, m2});
+    }
+
+    // rounded down to a power of 2 to map keys with a mask
+    const size_t tableSize = transpositionEntries_ ? size_t(1) << (63 - __builtin_clzll(
+                                                         transpositionEntries_)) : 0;
+    std::vector<TranspositionTable> tables(numThreads_, TranspositionTable(tableSize));
+
+    uint8_t bound = std::max<uint8_t>(1, heuristic(initialState_));
+    while (bound <= maxSolutionLength) {
+        LOG_IF(verbose_ && bound > 2, INFO) << "searching depth " << int(bound);
+        SearchContext context;
+        context.state = initialState_;
+        context.table = tableSize ? &tables[0] : nullptr;
+        uint8_t next = 0;
+        if (prefixes.empty() || bound <= kSplitDepth) {
+            next = search(context, bound);
+        } else {
+            // solutions of up to kSplitDepth moves aren't in the subtrees
+            next = search(context, kSplitDepth);
+            if (0 != next)
+                next = searchSubtrees(prefixes, bound, tables, context.path);
+        }
+        numVisitedStates_ += context.numVisitedStates;
+        if (0 == next) {
+            LOG_IF(verbose_, INFO) << "found solution: " << toString(context.path);
+            return context.path;
+        }
+        bound = next;
+    }
+    return {};
+}
+
+uint8_t BruteForceSolver::searchSubtrees(const std::vector<MoveSequence>& prefixes, uint8_t bound
+                                         , std::vector<TranspositionTable>& tables
+                                         , MoveSequence& solution) {
+    std::vector<SearchContext> contexts(prefixes.size());
+    std::vector<uint8_t> exceeding(prefixes.size(), kNoMove);
+    const auto searchSubtree = [&](unsigned worker, size_t i
+                                   , const std::atomic<size_t>& solvedTask) {
+        SearchContext& context = contexts[i];
+        context.state = initialState_;
+        for (uint8_t m: prefixes[i])
+            context.state.applyScrambleMove(m);
+        context.path = prefixes[i];
+        context.table = tables[worker].empty() ? nullptr : &tables[worker];
+        context.task = i;
+        context.solvedTask = &solvedTask;
+        const uint8_t estimate = prefixes[i].size()
+            + std::max<uint8_t>(1, heuristic(context.state));
+        exceeding[i] = (estimate > bound) ? estimate : search(context, bound);
+        numVisitedStates_ += context.numVisitedStates;
+        return 0 == exceeding[i];
+    };
+    const size_t solved = runTasks(prefixes.size(), searchSubtree);
+    if (solved < prefixes.size()) {
+        solution = std::move(contexts[solved].path);
+        return 0;
+    }
+    return *std::min_element(exceeding.begin(), exceeding.end());
+}
 
-        if (iterativeScramble_.size() != currentDepth) {
-            currentDepth = iterativeScramble_.size();
-            LOG_IF(currentDepth > 2, INFO) << "searching depth " << int(currentDepth);
+uint8_t BruteForceSolver::search(SearchContext& context, uint8_t bound) const {
+    ++context.numVisitedStates;
+    if (context.cancelled())
+        return kNoMove;
+    CubeState& state = context.state;
+    MoveSequence& path = context.path;
+    const uint8_t depth = path.size();
+    const uint8_t prev = path.empty() ? kNoMove : path.back();
+    if (depth + 1 >= bound)
+        return searchLeaves(context);
+
+    // skip the state if it was searched no deeper in this iteration after the same last move
+    TranspositionEntry* entry = nullptr;
+    uint64_t key = 0;
+    if (nullptr != context.table && 0 != depth) {
+        key = state.hash() ^ (prev * 0x9E3779B97F4A7C15ull);
+        entry = &(*context.table)[key & (context.table->size() - 1)];
+        if (entry->key == key && entry->bound == bound && entry->depth <= depth)
+            return depth + entry->exceeding;
+    }
+
+    // moves are applied going down and undone coming back up, the path is never replayed
+    uint8_t minExceeding = kNoMove;
+    path.push_back(kNoMove);
+    for (uint8_t m = 0; m < kNumAllQtmMoves; ++m) {
+        if (!allowedMoves_[m] || (kNoMove != prev && !canFollow(prev, m)))
+            continue;
+        state.applyScrambleMove(m);
+        path.back() = m;
+        if (state.isSolved())
+            return 0;
+        const uint8_t estimate = depth + 1 + std::max<uint8_t>(1, heuristic(state));
+        const uint8_t exceeding = (estimate > bound) ? estimate : search(context, bound);
+        if (0 == exceeding)
+            return 0;
+        if (kNoMove == exceeding && context.cancelled())
+            return kNoMove;
+        state.applyScrambleMove(oppoMove(m));
+        minExceeding = std::min(minExceeding, exceeding);
+    }
+    path.pop_back();
+    if (nullptr != entry)
+        *entry = {key, bound, depth, uint8_t(minExceeding - depth)};
+    return minExceeding;
+}
+
+uint8_t BruteForceSolver::searchLeaves(SearchContext& context) const {
+    // children are only checked, so each one is a copy: copying the state is cheaper than
+    // undoing a move
+    const CubeState& parent = context.state;
+    MoveSequence& path = context.path;
+    const uint8_t depth = path.size();
+    const uint8_t prev = path.empty() ? kNoMove : path.back();
+    uint8_t minExceeding = kNoMove;
+    path.push_back(kNoMove);
+    for (uint8_t m = 0; m < kNumAllQtmMoves; ++m) {
+        if (!allowedMoves_[m] || (kNoMove != prev && !canFollow(prev, m)))
+            continue;
+        CubeState child = parent;
+        child.applyScrambleMove(m);
+        if (child.isSolved()) {
+            path.back() = m;
+            return 0;
         }
-        ++iterativeScramble_;
+        minExceeding = std::min<uint8_t>(minExceeding
+                                         , depth + 1 + std::max<uint8_t>(1, heuristic(child)));
     }
+    path.pop_back();
+    return minExceeding;
+}
+
+namespace {
+
+// state near solved: applying moves brings it home. Moves are packed 6 bits each, length on top
+struct FrontierEntry {
+    uint64_t hash;
+    uint64_t packedMoves;
+
+    static constexpr uint8_t kBitsPerMove = 6;
+    static constexpr uint8_t kMaxMoves = 10;
+    uint8_t size() const {return packedMoves >> (kBitsPerMove * kMaxMoves);}
+    MoveSequence moves() const {
+        MoveSequence result(size());
+        for (size_t i = 0; i < result.size(); ++i)
+            result[i] = (packedMoves >> (kBitsPerMove * i)) & ((1 << kBitsPerMove) - 1);
+        return result;
+    }
+    static uint64_t pack(const MoveSequence& moves) {
+        uint64_t result = uint64_t(moves.size()) << (kBitsPerMove * kMaxMoves);
+        for (size_t i = 0; i < moves.size(); ++i)
+            result |= uint64_t(moves[i]) << (kBitsPerMove * i);
+        return result;
+    }
+    bool operator<(const FrontierEntry& other) const {return hash < other.hash;}
+};
+
+static_assert(kNumAllQtmMoves <= (1 << FrontierEntry::kBitsPerMove), "moves don't fit 6 bits");
 
-    return isSolved ? iterativeScramble_.get() : none;
+// calls visit(state, moves) for every canonical sequence of @param length moves of @param allowed
+// after @param moves applied to @param state, unless prune(state, moves) skips the subtree. Moves
+// are undone, so the state is the same afterwards. Stops when visit returns false.
+// @returns false if stopped
+template<typename Visit, typename Prune>
+bool forEachSequence(CubeState& state, MoveSequence& moves, uint8_t length, const MoveSet& allowed
+                     , const Visit& visit, const Prune& prune) {
+    if (moves.size() == length)
+        return visit(state, moves);
+    if (prune(state, moves))
+        return true;
+    const uint8_t prev = moves.empty() ? kNoMove : moves.back();
+    moves.push_back(kNoMove);
+    bool completed = true;
+    for (uint8_t m = 0; m < kNumAllQtmMoves && completed; ++m) {
+        if (!allowed[m] || (kNoMove != prev && !canFollow(prev, m)))
+            continue;
+        state.applyScrambleMove(m);
+        moves.back() = m;
+        completed = forEachSequence(state, moves, length, allowed, visit, prune);
+        state.applyScrambleMove(oppoMove(m));
+    }
+    moves.pop_back();
+    return completed;
+}
+
+// @returns layerSizes[d] = number of canonical sequences of d moves of @param allowed,
+// up to @param maxDepth
+std::vector<uint64_t> canonicalLayerSizes(uint8_t maxDepth, const MoveSet& allowed) {
+    std::vector<uint64_t> result{1};
+    std::vector<uint64_t> endingWith(allowed.begin(), allowed.end());
+    for (uint8_t d = 1; d <= maxDepth; ++d) {
+        result.push_back(std::accumulate(endingWith.begin(), endingWith.end(), uint64_t(0)));
+        std::vector<uint64_t> next(kNumAllQtmMoves, 0);
+        for (uint8_t prev = 0; prev < kNumAllQtmMoves; ++prev)
+            for (uint8_t m = 0; m < kNumAllQtmMoves; ++m)
+                if (allowed[m] && canFollow(prev, m))
+                    next[m] += endingWith[prev];
+        endingWith.swap(next);
+    }
+    return result;
+}
+
+} // namespace
+
+std::vector<MoveSequence> BruteForceSolver::solveMeetInTheMiddle(uint8_t maxSolutionLength
+                                                                 , bool all) {
+    numVisitedStates_ = 0;
+    // table depth: as many layers near solved as fit the memory bound
+    const uint8_t maxTableDepth = std::min<uint8_t>(FrontierEntry::kMaxMoves
+                                                    , (maxSolutionLength + 1) / 2);
+    const std::vector<uint64_t> layerSizes = canonicalLayerSizes(maxTableDepth, allowedMoves_);
+    uint8_t tableDepth = 0;
+    for (uint64_t numEntries = 1; tableDepth < maxTableDepth
+         && numEntries + layerSizes[tableDepth + 1] <= maxFrontierEntries_; ++tableDepth)
+        numEntries += layerSizes[tableDepth + 1];
+
+    // entries of solution suffixes c: the hash of the state that c solves
+    std::vector<FrontierEntry> table;
+    table.reserve(std::accumulate(layerSizes.begin(), layerSizes.begin() + tableDepth + 1
+                                  , uint64_t(0)));
+    const auto noPruning = [](const CubeState&, const MoveSequence&) {return false;};
+    MoveSequence moves;
+    CubeState solvedState;
+    for (uint8_t depth = 0; depth <= tableDepth; ++depth) {
+        const auto add = [&table](const CubeState& s, const MoveSequence& c) {
+            table.push_back({inverse(s).hash(), FrontierEntry::pack(c)});
+            return true;
+        };
+        forEachSequence(solvedState, moves, depth, allowedMoves_, add, noPruning);
+    }
+    std::sort(table.begin(), table.end());
+    LOG_IF(verbose_, INFO) << "meet in the middle table: " << table.size() << " states up to "
+              << int(tableDepth) << " moves from solved";
+
+    std::vector<MoveSequence> solutions;
+    CubeState state = initialState_;
+    for (uint8_t length = 1; length <= maxSolutionLength && solutions.empty(); ++length) {
+        const uint8_t suffixSize = std::min(tableDepth, length);
+        LOG_IF(verbose_ && length > 2, INFO) << "searching depth " << int(length);
+        // forward part can't be completed if the rest is shorter than the heuristic
+        const auto prune = [this, length](const CubeState& s, const MoveSequence& f) {
+            return nullptr != databases_ && f.size() + heuristic(s) > length;
+        };
+        const auto meet = [&](const CubeState& s, const MoveSequence& f) {
+            ++numVisitedStates_;
+            const FrontierEntry key{s.hash(), 0};
+            const auto range = std::equal_range(table.begin(), table.end(), key);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->size() != suffixSize)
+                    continue;
+                MoveSequence solution = it->moves();
+                if (!f.empty() && !solution.empty() && !canFollow(f.back(), solution.front()))
+                    continue;
+                CubeState solved = s;
+                for (uint8_t m: solution)
+                    solved.applyScrambleMove(m);
+                if (!solved.isSolved())
+                    continue; // hash collision
+                solution.insert(solution.begin(), f.begin(), f.end());
+                LOG_IF(verbose_, INFO) << "found solution: " << toString(solution);
+                solutions.push_back(std::move(solution));
+                if (!all)
+                    return false;
+            }
+            return true;
+        };
+        moves.clear();
+        forEachSequence(state, moves, length - suffixSize, allowedMoves_, meet, prune);
+    }
+    return solutions;
 }
@@ -4,15 +4,137 @@
 #include "incrementalscramble.h"
 #include "cubestate.h"
 #include "cube_moves.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+class PatternDatabases;
+
+enum class SolverStrategy {
+    BreadthSweep,   // replays every scramble in IncrementalScramble order
+    IdaStar,        // iterative deepening depth-first search pruned by pattern databases
+    MeetInTheMiddle // forward search from the state meets a table of states near solved
+};
+
+// default memory bound of the MeetInTheMiddle table, 16 bytes per entry
+constexpr size_t kDefaultMaxFrontierEntries = 1 << 22;
+
+// default size of the IdaStar transposition table of each thread, 16 bytes per entry.
+// Off: canonical move order already leaves few transpositions, the table rarely pays off
+constexpr size_t kDefaultTranspositionEntries = 0;
 
 // bruteforce solve specified CubeState, depth-first search
 class BruteForceSolver {
 public:
     BruteForceSolver(const CubeState& stateToSolve);
+
+    // first solution found, at most kMaxScrambleLength moves
     MovesArray solve(uint8_t maxSolutionLength = kMaxScrambleLength);
+
+    // like solve(), but solutions aren't limited by kMaxScrambleLength (BreadthSweep still is).
+    // @returns empty sequence if there's no solution within @param maxSolutionLength
+    MoveSequence solveSequence(uint8_t maxSolutionLength);
+
+    // all shortest solutions in canonical move order (see canFollow), MeetInTheMiddle only;
+    // other strategies return just the first one
+    std::vector<MoveSequence> solveAll(uint8_t maxSolutionLength);
+
+    void setStrategy(SolverStrategy strategy) {strategy_ = strategy;}
+
+    // heuristic of IdaStar and of the MeetInTheMiddle forward search, not owned.
+    // Without databases IdaStar is plain iterative deepening
+    void setPatternDatabases(const PatternDatabases* databases) {databases_ = databases;}
+
+    // MeetInTheMiddle stores at most @param maxEntries states near solved; the table is as deep
+    // as fits, the rest of the solution length is searched forward
+    void setMaxFrontierEntries(size_t maxEntries) {maxFrontierEntries_ = maxEntries;}
+
+    // BreadthSweep and IdaStar split the search into subtrees solved by @param numThreads
+    // threads. The solution is the same as with one thread: the first one in search order
+    void setNumThreads(unsigned numThreads) {numThreads_ = std::max(1u, numThreads);}
+
+    // IdaStar remembers up to @param numEntries (rounded down to a power of 2) states per
+    // thread that have no solution within the current bound, so that the same state reached
+    // by other moves isn't searched again. 0 disables the table
+    void setTranspositionTableSize(size_t numEntries) {transpositionEntries_ = numEntries;}
+
+    // solutions only use moves of @param allowedMoves, e.g. <R, U>. Pattern databases stay
+    // admissible: fewer moves never make the distance shorter
+    void setAllowedMoves(const MoveSet& allowedMoves) {allowedMoves_ = allowedMoves;}
+
+    // with @param verbose false, search depths and solutions aren't logged
+    void setVerbose(bool verbose) {verbose_ = verbose;}
+
+    // number of states visited by the last IdaStar or MeetInTheMiddle solve
+    uint64_t numVisitedStates() const {return numVisitedStates_;}
+
 private:
     CubeState initialState_;
-    IncrementalScramble iterativeScramble_;
+    SolverStrategy strategy_ = SolverStrategy::BreadthSweep;
+    const PatternDatabases* databases_ = nullptr;
+    size_t maxFrontierEntries_ = kDefaultMaxFrontierEntries;
+    unsigned numThreads_ = 1;
+    size_t transpositionEntries_ = kDefaultTranspositionEntries;
+    MoveSet allowedMoves_ = allMoves();
+    bool verbose_ = true;
+    std::atomic<uint64_t> numVisitedStates_ = 0;
+
+    // depth of the subtrees split off by parallel IdaStar, ~1700 subtrees
+    static constexpr uint8_t kSplitDepth = 2;
+
+    // state searched without solution: key mixes its hash with the last move (it limits the
+    // next moves), exceeding is the smallest exceeding depth + heuristic minus depth
+    struct TranspositionEntry {
+        uint64_t key = 0;
+        uint8_t bound = 0;
+        uint8_t depth = 0;
+        uint8_t exceeding = 0;
+    };
+    using TranspositionTable = std::vector<TranspositionEntry>; // direct-mapped by key
+
+    // state of the depth-first search of one thread
+    struct SearchContext {
+        CubeState state;                         // moves are applied and undone in place
+        MoveSequence path;                       // moves from initialState_
+        TranspositionTable* table = nullptr;     // table of the thread, if enabled
+        size_t task = 0;                         // rank of the subtree being searched
+        const std::atomic<size_t>* solvedTask = nullptr;
+        uint64_t numVisitedStates = 0;
+
+        // true when a lower-ranked subtree has a solution, so this one is useless
+        bool cancelled() const {
+            return nullptr != solvedTask && solvedTask->load(std::memory_order_relaxed) < task;
+        }
+    };
+
+    // solves task #i on thread #worker (reports if it has found a solution); tasks above
+    // @param solvedTask may stop early
+    using TaskFunction = std::function<bool(unsigned worker, size_t i
+                                            , const std::atomic<size_t>& solvedTask)>;
+
+    /// runs tasks [0, @param numTasks) on numThreads_ threads, lowest first. Once a task finds a
+    /// solution, higher tasks are cancelled: they don't start and running ones may stop early
+    /// @returns the lowest task that found a solution or @param numTasks if none did
+    size_t runTasks(size_t numTasks, const TaskFunction& run) const;
+
+    MoveSequence solveBreadthSweep(uint8_t maxSolutionLength);
+    MoveSequence solveIdaStar(uint8_t maxSolutionLength);
+    std::vector<MoveSequence> solveMeetInTheMiddle(uint8_t maxSolutionLength, bool all);
+
+    uint8_t heuristic(const CubeState& state) const;
+
+    /// depth-first search below @param context state reached by moves of its path
+    /// @returns 0 if solved within @param bound (solution in the path), otherwise the smallest
+    /// exceeding depth + heuristic. kNoMove if cancelled
+    uint8_t search(SearchContext& context, uint8_t bound) const;
+
+    /// search() of a node one move above the bound: only checks its children
+    uint8_t searchLeaves(SearchContext& context) const;
+
+    /// search of the subtrees after @param prefixes in parallel, see search()
+    /// @returns 0 and the lowest-ranked solution in @param solution or the smallest exceeding
+    uint8_t searchSubtrees(const std::vector<MoveSequence>& prefixes, uint8_t bound
+                           , std::vector<TranspositionTable>& tables, MoveSequence& solution);
 };
 
 #endif // BRUTEFORCESOLVER_H
@@ -1,15 +1,39 @@
 #include "commutatorfinder.h"
 #include "helpers.h"
 #include "cube_moves.h"
+#include "orbitkernels.h"
+#include "resultformat.h"
 #include <easylogging++.h>
+#include "workstealingqueues.h"
 #include <thread>
+#include <unistd.h>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
 using namespace std::chrono_literals;
 
+static_assert(std::atomic<bool>::is_always_lock_free, "stop flag is set by signal handlers");
+std::atomic<bool> CommutatorFinder::stopRequested_ = false;
+
 CommutatorFinder::CommutatorFinder(uint8_t maxMovesPartB
                                    , const SearchCriteria& criteria
                                    , std::string_view outputPath):
     maxMovesPartB_(maxMovesPartB)
   , criteria_(criteria)
+  , mode_(SearchMode::Incremental)
+  , useSymmetry_(false)
+  , numThreads_(1)
+  , shardIndex_(0)
+  , numShards_(1)
+  , resume_(false)
+  , binaryOutput_(false)
+  , relevantLayersOnly_(false)
+  , inertMoves_(InertMoves::Keep)
+  , allowedMoves_(allMoves())
+  , partBCounter_(allMoves())
+  , checkpointInterval_(60s)
   , outputPath_(outputPath)
   , numResults_(0)
   , lastLogging_(now())
@@ -17,83 +41,473 @@ CommutatorFinder::CommutatorFinder(uint8_t maxMovesPartB
 {
     LOG_IF(outputPath_.empty(), FATAL) << "empty outputPath";
     outputToDir_ = ('/' == outputPath_.back());
+    setUseSymmetry(false);
+    setRelevantLayersOnly(false);
+    for (size_t i = 0; i < caseMoves_.size(); ++i)
+        caseMoves_[i] = relevantMoves(CaseType(i));
     reset();
 }
 
 uint64_t CommutatorFinder::find() {
-    reset();
+    stopRequested_ = false;
+    if (useSymmetry_ && isRestricted(allowedMoves_)) {
+        // images of allowed algs may have other moves and vice versa
+        LOG(WARNING) << "symmetry is not used with restricted moves " << ::toString(allowedMoves_);
+        setUseSymmetry(false);
+    }
+    bool finished = false;
+    const bool resumed = resume_ && loadCheckpoint(finished);
+    if (!resumed) {
+        reset();
+        prepareOutputFiles();
+    }
     LOG(INFO) << "Begin commutators search. Max partB = " << int(maxMovesPartB_) << " moves. "
               << "Results will be saved to "
-              << (outputToDir_ ? (outputPath_+"*.txt") : outputPath_);
+              << (outputToDir_ ? (outputPath_+"*.txt") : outputPath_)
+              << ". Move kernel: " << bestOrbitKernel().name
+              << (resumed ? ". Resumed from " + checkpointPath() : "")
+              << (SearchMode::DepthFirst == mode_ ? ". Depth-first"
+                  : SearchMode::PartBFirst == mode_ ? ". PartB-first" : "")
+              << (useSymmetry_ ? ". Symmetry-reduced" : "")
+              << (isRestricted(allowedMoves_) ? ". Moves: " + ::toString(allowedMoves_) : "")
+              << (numThreads_ > 1 ? ". Depth-first, threads: " + std::to_string(numThreads_)
+                                  : "")
+              << (numShards_ > 1 ? ". Shard " + std::to_string(shardIndex_ + 1) + "/"
+                                   + std::to_string(numShards_) : "");
+    if (finished) {
+        LOG(INFO) << "Search is already finished";
+        return numResults_;
+    }
+    // partA not searched themselves are still paired with partB = "L"
+    for (uint8_t a = 0; a < kNumAllQtmMoves && 0 == shardIndex_ && !resumed; ++a)
+        if (!searchedPartA_[a])
+            evaluateParallelFirstPartB(a);
+    numCandidates_ = 0;
+    for (uint8_t a = nextPartA(0); a < kNumAllQtmMoves; a = nextPartA(a + 1))
+        numCandidates_ += numPartBCandidates(a);
+    startTime_ = now();
+    lastCheckpoint_ = now();
+    numDoneCandidatesAtStart_ = searchesByTasks() ? 0 : numDoneCandidates();
+    if (searchesByTasks())
+        findByTasks(resumed);
+    else if (SearchMode::PartBFirst == mode_)
+        findPartBFirst();
+    else
+        findIncremental();
+    // a finished shard keeps its checkpoint: it tells mergeShards that the shard is complete.
+    // A finished single run needs none, so only its results stay in the output layout
+    if (stopRequested_ || numShards_ > 1)
+        saveCheckpoint(!stopRequested_);
+    else
+        removeCheckpoint();
+    if (stopRequested_)
+        LOG(INFO) << "Search stopped. Found " << numResults_ << " commutators so far. "
+                  << "Run again with resume to continue from " << checkpointPath();
+    else
+        printFinishMessage();
+    return numResults_;
+}
+
+void CommutatorFinder::setResume(bool resume) {
+    resume_ = resume;
+}
+
+void CommutatorFinder::setRelevantLayersOnly(bool relevantLayersOnly) {
+    relevantLayersOnly_ = relevantLayersOnly;
+    updateRelevantMoves();
+}
+
+void CommutatorFinder::setAllowedMoves(const MoveSet& moves) {
+    allowedMoves_ = moves;
+    updateRelevantMoves();
+}
+
+void CommutatorFinder::updateRelevantMoves() {
+    relevantMoves_ = allowedMoves_;
+    if (relevantLayersOnly_) {
+        const MoveSet relevant = criteria_.relevantMoves();
+        for (uint8_t m = 0; m < kNumAllQtmMoves; ++m)
+            relevantMoves_[m] = relevantMoves_[m] && relevant[m];
+    }
+    restrictsMoves_ = isRestricted(relevantMoves_);
+    partBCounter_ = ScrambleCounter(relevantMoves_);
+}
+
+void CommutatorFinder::setInertMoves(InertMoves inertMoves) {
+    inertMoves_ = inertMoves;
+}
+
+void CommutatorFinder::setBinaryOutput(bool binaryOutput) {
+    binaryOutput_ = binaryOutput;
+}
+
+void CommutatorFinder::setCheckpointInterval(std::chrono::seconds interval) {
+    checkpointInterval_ = interval;
+}
+
+void CommutatorFinder::requestStop() {
+    stopRequested_ = true;
+}
+
+void CommutatorFinder::setSearchMode(SearchMode mode) {
+    mode_ = mode;
+}
+
+void CommutatorFinder::setNumThreads(unsigned numThreads) {
+    numThreads_ = std::max(1u, numThreads);
+}
+
+void CommutatorFinder::setShard(unsigned index, unsigned numShards) {
+    LOG_IF(0 == numShards || index >= numShards, FATAL) << "invalid shard " << index
+            << " of " << numShards;
+    shardIndex_ = index;
+    numShards_ = numShards;
+}
+
+void CommutatorFinder::setUseSymmetry(bool useSymmetry) {
+    useSymmetry_ = useSymmetry;
+    for (uint8_t a = 0; a < kNumAllQtmMoves; ++a) {
+        searchedPartA_[a] = !useSymmetry_ || symmetryRepresentative(a) == a;
+        partAImages_[a].clear();
+    }
+    if (!useSymmetry_)
+        return;
+    // one symmetry per image is enough: it maps all partB of the representative
+    // onto all partB of the image
+    for (uint8_t a = 0; a < kNumAllQtmMoves; ++a) {
+        if (!searchedPartA_[a])
+            continue;
+        std::array<bool, kNumAllQtmMoves> isImage{};
+        isImage[a] = true;
+        for (const MoveMap& map: symmetryMoveMaps()) {
+            if (!isImage[map[a]]) {
+                isImage[map[a]] = true;
+                partAImages_[a].emplace_back(map[a], &map);
+            }
+        }
+    }
+}
+
+uint8_t CommutatorFinder::nextPartA(uint8_t partA) const {
+    while (partA < kNumAllQtmMoves && (!searchedPartA_[partA] || !relevantMoves_[partA]))
+        ++partA;
+    return partA;
+}
+
+void CommutatorFinder::findIncremental() {
     uint32_t count = 0; // for occasional logging
-    uint8_t i;
-    while (true) {
-        CubeState state;
-        // apply commutator
+    // B = b0 B1. The first move b0 increments fastest, so B1 (tail) and its inverse are cached
+    // and [A, B] = A b0 B1 A' B1' b0' is composed from cached states
+    MovesArray cachedTail = emptyMovesArray();
+    CubeState tail, tailInverse;
+    // checkpoints of older versions may stop at a partA that isn't searched
+    if (partA_ != nextPartA(partA_)) {
+        partA_ = nextPartA(partA_);
+        partB_.reset();
+    }
+    if (partA_ < kNumAllQtmMoves)
+        skipIrrelevantPartB(partA_);
+    while (partA_ < kNumAllQtmMoves) {
+        if (partB_.size() > maxMovesPartB_) {
+            partB_.reset();
+            const uint8_t donePartA = partA_;
+            partA_ = nextPartA(partA_ + 1);
+            if (partA_ >= kNumAllQtmMoves)
+                return;
+            printPartAdoneMessage(donePartA);
+            // the first partB of each partA is filtered like all the others
+            skipIrrelevantPartB(partA_);
+            continue;
+        }
+
+        // report progress and save checkpoints based on time. Everything before partB_ is done
+        if (++count%1000 == 0) {
+            printOccasionalProgressReport();
+            if (checkpointIfNeeded())
+                return;
+        }
+
         const MovesArray& moves = partB_.get();
-        i = 0;
-        // apply A B A' B'
-        state.applyScrambleMove(partA_);
-        while (i < moves.size() && moves[i] != kNoMove)
-            state.applyScrambleMove(moves[i++]);
-        state.applyScrambleMove(oppoMove(partA_));
-        while (i>0)
-            state.applyScrambleMove(oppoMove(moves[--i]));
+        MovesArray currentTail = emptyMovesArray();
+        std::copy(moves.begin() + 1, moves.end(), currentTail.begin());
+        if (currentTail != cachedTail) {
+            cachedTail = currentTail;
+            tail = CubeState().applyScramble(cachedTail);
+            tailInverse = inverse(tail);
+        }
+        CubeState state = compose(compose(compose(compose(compose(
+                CubeState::moveState(partA_), CubeState::moveState(moves[0])), tail),
+                CubeState::moveState(oppoMove(partA_))), tailInverse),
+                CubeState::moveState(oppoMove(moves[0])));
 
         // see if we've found something interesting
-        CaseType ct = state.getCaseType(criteria_);
-        if (CaseType::caseTypeEnd != ct)
-            onFoundResult(ct, state);
+        evaluate(state, partA_, moves);
 
         // increment partB_
         partB_.incAndSkipParallelBeginEnd(partA_);
+        skipIrrelevantPartB(partA_);
+    }
+}
+
+void CommutatorFinder::findByTasks(bool resumed) {
+    // tasks are subtrees of the depth-first search: partA and the last move of partB.
+    // Every thread searches with its own states and moves, only results are shared.
+    // Shards take every numShards_-th task, so they need no coordination
+    struct Task {
+        uint8_t partA, lastMove;
+        size_t index;
+    };
+    auto numTaskCandidates = [this](const Task& task) {
+        uint64_t result = 0;
+        for (uint8_t size = 1; size <= maxMovesPartB_; ++size)
+            result += partBCounter_.count(size, task.partA, task.lastMove + 1)
+                    - partBCounter_.count(size, task.partA, task.lastMove);
+        return result;
+    };
+    WorkStealingQueues<Task> queues(numThreads_);
+    size_t numTasks = 0, numShardTasks = 0;
+    numCandidates_ = 0;
+    numParallelDoneCandidates_ = 0;
+    for (uint8_t a = nextPartA(0); a < kNumAllQtmMoves; a = nextPartA(a + 1)) {
+        if (0 == shardIndex_ && searchesParallelFirstPartB(a)) {
+            if (!resumed)
+                evaluateParallelFirstPartB(a);
+            ++numCandidates_;
+            ++numParallelDoneCandidates_;
+        }
+        for (uint8_t x = 0; x < kNumAllQtmMoves; ++x) {
+            if (areParallelLayersMoves(x, a))
+                continue;
+            const Task task{a, x, numTasks++};
+            if (task.index % numShards_ != shardIndex_ || !relevantMoves_[x])
+                continue;
+            numCandidates_ += numTaskCandidates(task);
+            if (task.index < doneTasks_.size() && doneTasks_[task.index])
+                numParallelDoneCandidates_ += numTaskCandidates(task);
+            else
+                queues.push(numShardTasks++ % numThreads_, task);
+        }
+    }
+    doneTasks_.resize(numTasks, false);
+    numDoneCandidatesAtStart_ = numParallelDoneCandidates_;
+
+    // checkpoints need all output of done tasks and nothing else. Results of a running task
+    // are kept by its thread; a done task hands them to the writer and is marked done under
+    // tasksMutex, which the checkpoint holds too, so no thread waits for running tasks
+    std::mutex tasksMutex;
+    std::condition_variable allDone;
+    unsigned numWorking = numThreads_;
+    auto work = [&](unsigned worker) {
+        TaskResults results;
+        for (Task task; !stopRequested_ && queues.pop(worker, task);) {
+            MovesArray moves = emptyMovesArray();
+            searchDepthFirstFrom(task.partA, moves, 0, task.lastMove
+                                 , CubeState::moveState(oppoMove(task.partA)), results);
+            if (stopRequested_) // the task may be incomplete
+                break;
+            std::lock_guard<std::mutex> lock(tasksMutex);
+            writeTaskResults(results);
+            doneTasks_[task.index] = true;
+            numParallelDoneCandidates_ += numTaskCandidates(task);
+        }
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        if (0 == --numWorking)
+            allDone.notify_all();
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < numThreads_; ++i)
+        threads.emplace_back(work, i);
+
+    // this thread reports progress and saves checkpoints on time. Stop requests come from
+    // signal handlers, which can't notify: they're polled
+    std::unique_lock<std::mutex> lock(tasksMutex);
+    while (!allDone.wait_for(lock, 100ms, [&] {return 0 == numWorking;})) {
+        printOccasionalProgressReport();
+        if (!stopRequested_ && now() - lastCheckpoint_ >= checkpointInterval_)
+            saveCheckpoint(false);
+    }
+    lock.unlock();
+    for (auto& thread: threads)
+        thread.join();
+}
+
+void CommutatorFinder::evaluateParallelFirstPartB(uint8_t partA) {
+    // incremental search always starts with partB = "L", even when it's parallel to partA
+    constexpr uint8_t kFirstMove = 0;
+    if (!searchesParallelFirstPartB(partA))
+        return;
+    MovesArray first = emptyMovesArray();
+    first[0] = kFirstMove;
+    CubeState state = compose(compose(compose(CubeState::moveState(partA),
+            CubeState::moveState(kFirstMove)), CubeState::moveState(oppoMove(partA))),
+            CubeState::moveState(oppoMove(kFirstMove)));
+    evaluate(state, partA, first);
+}
+
+bool CommutatorFinder::searchesParallelFirstPartB(uint8_t partA) const {
+    // not when L is filtered out: skipIrrelevantPartB skips the first partB then
+    return areParallelLayersMoves(partA, 0) && relevantMoves_[partA] && relevantMoves_[0];
+}
 
-        // report progress based on time
-        if (++count%1000 == 0)
+void CommutatorFinder::findPartBFirst() {
+    uint32_t count = 0; // for occasional logging
+    // B and B' are built once (from the cached tail, as in findIncremental) and shared by
+    // all partA: [A, B] = A B A' B' costs three compositions per candidate
+    MovesArray cachedTail = emptyMovesArray();
+    CubeState tail, tailInverse;
+    for (skipIrrelevantPartB(kNoMove); partB_.size() <= maxMovesPartB_
+         ; ++partB_, skipIrrelevantPartB(kNoMove)) {
+        // everything before partB_ is done
+        if (++count%100 == 0) {
             printOccasionalProgressReport();
+            if (checkpointIfNeeded())
+                return;
+        }
 
-        if (partB_.size() > maxMovesPartB_) {
-            partB_.reset();
-            partA_++;
-            if (partA_ >= kNumAllQtmMoves) {
-                printFinishMessage();
-                return numResults_;
-            } else {
-                printPartAdoneMessage();
-            }
+        const MovesArray& moves = partB_.get();
+        MovesArray currentTail = emptyMovesArray();
+        std::copy(moves.begin() + 1, moves.end(), currentTail.begin());
+        if (currentTail != cachedTail) {
+            cachedTail = currentTail;
+            tail = CubeState().applyScramble(cachedTail);
+            tailInverse = inverse(tail);
+        }
+        const CubeState b = compose(CubeState::moveState(moves[0]), tail);
+        const CubeState bInverse = compose(tailInverse, CubeState::moveState(oppoMove(moves[0])));
+
+        // same partA as incAndSkipParallelBeginEnd allows. Incremental search always
+        // starts with partB = "L", even when it's parallel to partA
+        const uint8_t first = moves[0], last = moves[partB_.size() - 1];
+        const bool isFirstPartB = (1 == partB_.size() && 0 == first);
+        for (uint8_t a = 0; a < kNumAllQtmMoves; ++a) {
+            if (!searchedPartA_[a] || !relevantMoves_[a])
+                continue;
+            if (!isFirstPartB && (areParallelLayersMoves(a, first)
+                                  || areParallelLayersMoves(a, last)))
+                continue;
+            CubeState state = compose(compose(compose(CubeState::moveState(a), b),
+                    CubeState::moveState(oppoMove(a))), bInverse);
+            evaluate(state, a, moves);
         }
     }
 }
 
+void CommutatorFinder::searchDepthFirst(uint8_t partA, MovesArray& moves, uint8_t depth
+                                        , const CubeState& conjugate, TaskResults& results) {
+    // a task may take minutes: stop requests are checked inside it, its results are dropped
+    if (stopRequested_.load(std::memory_order_relaxed))
+        return;
+    for (uint8_t x = 0; x < kNumAllQtmMoves; ++x) {
+        if (0 == depth ? areParallelLayersMoves(x, partA) : !canFollow(x, moves[depth-1]))
+            continue;
+        if (!relevantMoves_[x])
+            continue;
+        searchDepthFirstFrom(partA, moves, depth, x, conjugate, results);
+    }
+    moves[depth] = kNoMove;
+}
+
+void CommutatorFinder::searchDepthFirstFrom(uint8_t partA, MovesArray& moves, uint8_t depth
+                                            , uint8_t x, const CubeState& conjugate
+                                            , TaskResults& results) {
+    // partB = x T: [A, x T] = A (x (T A' T') x'). T A' T' is conjugate, partB is prepended
+    // one move at a time, so each node costs two compositions instead of the whole 4N+2 moves
+    moves[depth] = x;
+    CubeState next = compose(compose(CubeState::moveState(x), conjugate),
+                             CubeState::moveState(oppoMove(x)));
+    if (!areParallelLayersMoves(x, partA)) {
+        MovesArray partB = emptyMovesArray();
+        for (uint8_t i = 0; i <= depth; ++i)
+            partB[i] = moves[depth - i];
+        CubeState state = compose(CubeState::moveState(partA), next);
+        evaluate(state, partA, partB, &results);
+    }
+    if (depth + 1 < maxMovesPartB_)
+        searchDepthFirst(partA, moves, depth + 1, next, results);
+}
+
+void CommutatorFinder::evaluate(CubeState& cube, uint8_t partA, const MovesArray& partB
+                                , TaskResults* results) {
+    CaseType ct = cube.getCaseType(criteria_);
+    if (CaseType::caseTypeEnd == ct)
+        return;
+    if (useSymmetry_)
+        evaluateSymmetricImages(partA, partB, results);
+    onFoundResult(ct, cube, partA, partB, results);
+}
+
+void CommutatorFinder::evaluateSymmetricImages(uint8_t searchedPartA, const MovesArray& partB
+                                               , TaskResults* results) {
+    // partB parallel to partA is only searched as [A, L]; its images are not searched at all
+    if (areParallelLayersMoves(searchedPartA, partB[0]))
+        return;
+    // symmetries keep the CaseType, but the image is rebuilt anyway: its cycles are listed
+    // starting from its own first unsolved sticker, exactly as if it was found by the search
+    for (const auto& [partA, map]: partAImages_[searchedPartA]) {
+        const MovesArray image = applyMoveMap(*map, partB);
+        CubeState state = commutator(CubeState::moveState(partA)
+                                     , CubeState().applyScramble(image));
+        CaseType ct = state.getCaseType(criteria_);
+        if (CaseType::caseTypeEnd != ct)
+            onFoundResult(ct, state, partA, image, results);
+    }
+}
+
+void CommutatorFinder::skipIrrelevantPartB(uint8_t parallelTo) {
+    while (restrictsMoves_ && partB_.size() <= maxMovesPartB_) {
+        // the last move changes slowest: skip the subtree below the last irrelevant move
+        const MovesArray& moves = partB_.get();
+        int i = int(partB_.size()) - 1;
+        while (i >= 0 && relevantMoves_[moves[i]])
+            --i;
+        if (i < 0)
+            return;
+        partB_.skipSubtree(i, parallelTo);
+    }
+}
+
 std::string CommutatorFinder::toString(bool commutatorNotation) const {
+    return commutatorToString(partA_, partB_.get(), commutatorNotation);
+}
+
+std::string commutatorToString(uint8_t partA, const MovesArray& partB, bool commutatorNotation) {
     if (commutatorNotation)
-        return "[" + moveToString(partA_) + ", " + partB_.toString() + "]";
-    std::string fullScramble = moveToString(partA_) + " " + partB_.toString() + " "
-                + moveToString(oppoMove(partA_));
-    for (int i = partB_.size() - 1; i >= 0; --i)
-        fullScramble += " " + moveToString(oppoMove(partB_.get()[i]));
+        return "[" + moveToString(partA) + ", " + toString(partB) + "]";
+    std::string fullScramble = moveToString(partA) + " " + toString(partB) + " "
+                + moveToString(oppoMove(partA));
+    for (int i = numMoves(partB) - 1; i >= 0; --i)
+        fullScramble += " " + moveToString(oppoMove(partB[i]));
     return fullScramble;
 }
 
 void CommutatorFinder::reset() {
     numResults_ = 0;
-    partA_ = uint8_t(0);
+    partA_ = nextPartA(0);
     partB_.reset();
+    doneTasks_.clear();
     lastLogging_ = now();
     lastResultPartA_ = 0;
+}
 
+void CommutatorFinder::prepareOutputFiles() {
     // check if output files(s) available; create/clear them
+    writer_.closeFiles();
     if (outputToDir_) {
         for (size_t i = 0; i < size_t(CaseType::caseTypeEnd); ++i) {
             CaseType ct = static_cast<CaseType>(i);
-            std::string filePath = pathToOutFile(ct);
-            auto contents = getFileContents(filePath, true);
-            LOG_IF(!contents.empty() && !saveToFile(filePath, "", false), FATAL)
-                    << "can\'t open file " << filePath << " for writing";
+            for (uint8_t partBsize = 1; partBsize <= maxMovesPartB_; ++partBsize) {
+                std::string filePath = pathToOutFile(ct, partBsize);
+                std::error_code error;
+                if (0 == std::filesystem::file_size(filePath, error) || error)
+                    continue;
+                std::filesystem::resize_file(filePath, 0, error);
+                LOG_IF(error, FATAL) << "can\'t open file " << filePath << " for writing";
+            }
         }
     } else {
-        bool fileIsOk = saveToFile(outputPath_, "", false);
-        LOG_IF(!fileIsOk, FATAL) << "Can\'t write to file: " << outputPath_;
+        bool fileIsOk = saveToFile(pathToOutFile(CaseType::caseTypeEnd, 0), "", false);
+        LOG_IF(!fileIsOk, FATAL) << "Can\'t write to file: "
+                                 << pathToOutFile(CaseType::caseTypeEnd, 0);
     }
 }
 
@@ -102,51 +516,429 @@ void CommutatorFinder::printFinishMessage() const {
               << int(maxMovesPartB_) << " moves. Results saved to " << outputPath_;
 }
 
-void CommutatorFinder::printPartAdoneMessage() const {
+void CommutatorFinder::printPartAdoneMessage(uint8_t partA) const {
     uint64_t resultsForPartB = numResults_ - lastResultPartA_;
     lastResultPartA_ = numResults_;
     LOG(INFO) << "Finished partA = "
-              << moveToString(partA_-1) << ", found " << resultsForPartB
+              << moveToString(partA) << ", found " << resultsForPartB
               << " comms with " << int(maxMovesPartB_)
               << "-move-partB. Total comms found: " << numResults_;
     lastLogging_ = now();
 }
 
-void CommutatorFinder::onFoundResult(CaseType caseType, CubeState& cube) {
-    // TODO if the element of castType isn't located on some layers (e.g. corners aren't located
-    // on layers M, l, b etc., then discard the alg if it has these layer moves
-    ++numResults_;
-    auto outputFilePath = outputToDir_
-            ? pathToOutFile(caseType) : outputPath_;
+void CommutatorFinder::onFoundResult(CaseType caseType, CubeState& cube, uint8_t partA
+                                     , const MovesArray& partB, TaskResults* results) {
+    // symmetric images and [A, L] aren't generated from allowed moves
+    if (restrictsMoves_ && (!allowedMoves_[partA]
+                            || std::any_of(partB.begin(), partB.begin() + numMoves(partB)
+                                           , [this](uint8_t m) {return !allowedMoves_[m];})))
+        return;
+    if (relevantLayersOnly_) {
+        // e.g. corners aren't located on layers M, l, b: such moves play no role in corner algs
+        const auto& relevant = caseMoves_[size_t(caseType)];
+        if (!relevant[partA] || std::any_of(partB.begin(), partB.begin() + numMoves(partB)
+                                            , [&](uint8_t m) {return !relevant[m];}))
+            return;
+    }
     // cube.solveAndGetCycles() will print centers cycles as well. Replace with asterics
-    std::string delimeter = ": ";
-    if (!isCenterCaseType(caseType) && !cube.centersAreSolved()
-            && CenterSafety::StrictCenterSafe != criteria_.getCenterSafety()) {
-        cube.resetCenters();
-        delimeter = "*" + delimeter;
+    const bool resetCenters = !isCenterCaseType(caseType) && !cube.centersAreSolved()
+            && CenterSafety::StrictCenterSafe != criteria_.getCenterSafety();
+    const bool hasInertMove = InertMoves::Keep != inertMoves_
+            && kNoMove != findInertMove(partA, partB, cube, !resetCenters);
+    if (hasInertMove && InertMoves::Drop == inertMoves_)
+        return;
+    auto outputFilePath = pathToOutFile(caseType, numMoves(partB));
+    std::string contents;
+    if (binaryOutput_) {
+        // cycles are computed from the commutator on export
+        contents = encodeRecord({partA, partB, caseType, resetCenters, hasInertMove});
+    } else {
+        std::string delimeter = ": ";
+        if (resetCenters) {
+            cube.resetCenters();
+            delimeter = "*" + delimeter;
+        }
+        contents = cube.solveAndGetCycles() + delimeter + commutatorToString(partA, partB)
+                + (hasInertMove ? std::string(kInertMoveTag) : "") + "\n";
     }
-    std::string contents = cube.solveAndGetCycles() + delimeter + this->toString() + "\n";
-    bool saved = false;
-    do {
-        saved = saveToFile(outputFilePath, contents, true);
-        if (!saved) {
-            LOG(ERROR) << "failed to save to " << outputFilePath << ". Retrying in 10s";
-            std::this_thread::sleep_for(10s);
+    if (nullptr != results) {
+        results->emplace_back(std::move(outputFilePath), std::move(contents));
+        return;
+    }
+    ++numResults_;
+    if (binaryOutput_)
+        writer_.writeRecord(outputFilePath, std::move(contents));
+    else
+        writer_.write(outputFilePath, std::move(contents));
+}
+
+void CommutatorFinder::writeTaskResults(TaskResults& results) {
+    for (auto& [path, contents]: results) {
+        if (binaryOutput_)
+            writer_.writeRecord(path, std::move(contents));
+        else
+            writer_.write(path, std::move(contents));
+    }
+    numResults_ += results.size();
+    results.clear();
+}
+
+uint8_t findInertMove(uint8_t partA, const MovesArray& partB, const CubeState& state
+                      , bool compareCenters) {
+    // B without move #i is prefix[i] suffix[i+1]: each candidate costs a few compositions
+    // instead of replaying the whole commutator
+    const uint8_t size = numMoves(partB);
+    std::array<CubeState, kMaxScrambleLength + 1> prefix, suffix;
+    for (uint8_t i = 0; i < size; ++i)
+        prefix[i + 1] = compose(prefix[i], CubeState::moveState(partB[i]));
+    for (uint8_t i = size; i-- > 0;)
+        suffix[i] = compose(CubeState::moveState(partB[i]), suffix[i + 1]);
+    CubeState expected = state;
+    if (!compareCenters)
+        expected.resetCenters();
+    for (uint8_t i = 0; i < size; ++i) {
+        const CubeState b = compose(prefix[i], suffix[i + 1]);
+        CubeState result = compose(compose(compose(CubeState::moveState(partA), b),
+                CubeState::moveState(oppoMove(partA))), inverse(b));
+        if (!compareCenters)
+            result.resetCenters();
+        if (result == expected)
+            return i;
+    }
+    return kNoMove;
+}
+
+std::string CommutatorFinder::pathToOutFile(CaseType ct, uint8_t partBsize) const {
+    const std::string path = outputToDir_
+            ? resultsFilePath(outputPath_, ct, partBsize, binaryOutput_) : outputPath_;
+    return numShards_ > 1 ? shardFilePath(path, shardIndex_, numShards_) : path;
+}
+
+std::string resultsFilePath(std::string_view outputDir, CaseType ct, uint8_t partBsize
+                            , bool binary) {
+    return std::string(outputDir) + ::toString(ct) + std::to_string(partBsize)
+            + (binary ? "moves.bin" : "moves.txt");
+}
+
+std::string shardFilePath(std::string_view path, unsigned index, unsigned numShards) {
+    return std::string(path) + ".shard" + std::to_string(index + 1) + "of"
+            + std::to_string(numShards);
+}
+
+// @returns true if shard checkpoint @param path says the shard is finished and all its output
+// files have the recorded sizes, otherwise logs why not
+static bool shardIsFinished(const std::string& path) {
+    std::istringstream contents(getFileContents(path, true));
+    bool finished = false;
+    for (std::string line, key; std::getline(contents, line);) {
+        std::istringstream values(line);
+        values >> key;
+        if ("finished" == key) {
+            values >> finished;
+        } else if ("file" == key) {
+            uintmax_t size;
+            std::string file;
+            values >> size;
+            std::getline(values >> std::ws, file);
+            std::error_code error;
+            const uintmax_t actualSize = std::filesystem::file_size(file, error);
+            if ((error ? 0 : actualSize) != size) {
+                LOG(ERROR) << "shard file " << file << " has " << (error ? 0 : actualSize)
+                           << " bytes, its checkpoint " << path << " says " << size;
+                return false;
+            }
+        }
+    }
+    LOG_IF(!finished, ERROR) << "shard is not finished: "
+                             << (contents.str().empty() ? "no checkpoint " : "checkpoint ")
+                             << path << ". Run it again with --resume";
+    return finished;
+}
+
+// appends shard files of @param path to it
+// @returns number of merged results or -1 if a binary shard is broken
+static int64_t mergeShardFiles(const std::string& path, unsigned numShards, bool binary) {
+    std::ofstream merged(path, std::ios::binary | std::ios::trunc);
+    LOG_IF(!merged, FATAL) << "can't open file " << path << " for writing";
+    if (binary)
+        merged << resultFileHeader();
+    int64_t numResults = 0;
+    for (unsigned i = 0; i < numShards; ++i) {
+        // a shard that found nothing may have no file in a directory layout
+        const std::string shardPath = shardFilePath(path, i, numShards);
+        if (!std::filesystem::exists(shardPath))
+            continue;
+        if (binary) {
+            // blocks are copied as they are, after their checksums are verified
+            ResultReader reader(shardPath);
+            for (std::string records; reader.readBlock(records);) {
+                merged << resultBlock(records);
+                numResults += records.size() / kResultRecordSize;
+            }
+            if (!reader.error().empty()) {
+                LOG(ERROR) << reader.error();
+                return -1;
+            }
+            continue;
+        }
+        std::ifstream shard(shardPath, std::ios::binary);
+        for (std::string line; std::getline(shard, line); ++numResults)
+            merged << line << '\n';
+    }
+    LOG_IF(!merged.flush(), FATAL) << "failed to write " << path;
+    return numResults;
+}
+
+int64_t mergeShards(std::string_view outputPath, uint8_t maxMovesPartB, unsigned numShards
+                    , bool binary, bool deleteInputs) {
+    bool allFinished = true;
+    for (unsigned i = 0; i < numShards; ++i)
+        allFinished = shardIsFinished(checkpointFilePath(outputPath, i, numShards)) && allFinished;
+    if (!allFinished)
+        return -1;
+
+    // same layout as CommutatorFinder: one file or a file per case type and partB size
+    std::vector<std::string> paths;
+    if ('/' != outputPath.back()) {
+        paths.emplace_back(outputPath);
+    } else {
+        for (size_t i = 0; i < size_t(CaseType::caseTypeEnd); ++i)
+            for (uint8_t partBsize = 1; partBsize <= maxMovesPartB; ++partBsize)
+                paths.push_back(resultsFilePath(outputPath, CaseType(i), partBsize, binary));
+    }
+    int64_t total = 0;
+    for (const auto& path: paths) {
+        const int64_t numResults = mergeShardFiles(path, numShards, binary);
+        if (numResults < 0)
+            return -1;
+        total += numResults;
+    }
+    if (deleteInputs) {
+        for (unsigned i = 0; i < numShards; ++i) {
+            for (const auto& path: paths)
+                std::remove(shardFilePath(path, i, numShards).c_str());
+            std::remove(checkpointFilePath(outputPath, i, numShards).c_str());
         }
-    } while (!saved);
+    }
+    return total;
 }
 
-std::string CommutatorFinder::pathToOutFile(CaseType ct) const {
-    return outputPath_ + ::toString(ct) + std::to_string(partB_.size()) + "moves.txt";
+// @returns e.g. "2d 3h 4m 5s"
+static std::string durationToString(double seconds) {
+    uint64_t s = seconds;
+    std::string result = std::to_string(s % 60) + "s";
+    if (s /= 60)
+        result = std::to_string(s % 60) + "m " + result;
+    if (s /= 60)
+        result = std::to_string(s % 24) + "h " + result;
+    if (s /= 24)
+        result = std::to_string(s) + "d " + result;
+    return result;
 }
 
 void CommutatorFinder::printOccasionalProgressReport() const {
     constexpr auto kLogProgressInterval = 5s;
     if (now() - lastLogging_ < kLogProgressInterval)
         return;
-    LOG(INFO) << "progress: partA = " << moveToString(partA_) << " ("
-              << int(1+partA_) << "/" << int(kNumAllQtmMoves) << " mv), partB "
-              << int(partB_.size()) << "/" << int(maxMovesPartB_)
-              << " mv = " << partB_.progress() << ". Total comms: " << numResults_;
+    const uint64_t done = numDoneCandidates();
+    const double seconds = std::chrono::duration<double>(now() - startTime_).count();
+    const double rate = (done - numDoneCandidatesAtStart_) / seconds;
+    std::string position;
+    if (searchesByTasks()) {
+        position = "depth-first, " + std::to_string(numThreads_) + " thread(s)";
+    } else if (SearchMode::PartBFirst == mode_) {
+        position = "partB " + std::to_string(partB_.size()) + "/"
+                + std::to_string(maxMovesPartB_) + " mv = " + partB_.progress();
+    } else {
+        position = "partA = " + moveToString(partA_) + " (" + std::to_string(1+partA_) + "/"
+                + std::to_string(kNumAllQtmMoves) + " mv), partB "
+                + std::to_string(partB_.size()) + "/" + std::to_string(maxMovesPartB_)
+                + " mv = " + partB_.progress();
+    }
+    LOG(INFO) << "progress: " << position << ". Comms evaluated: " << done << "/"
+              << numCandidates_ << " (" << 100. * done / numCandidates_ << "%), "
+              << uint64_t(rate) << "/s, ETA "
+              << (rate > 0 ? durationToString((numCandidates_ - done) / rate) : "unknown")
+              << ". Total comms: " << numResults_;
+    lastLogging_ = now();
+}
+
+uint64_t CommutatorFinder::numPartBCandidates(uint8_t partA) const {
+    // incremental search always starts with partB = "L", even when it's parallel to partA
+    uint64_t result = searchesParallelFirstPartB(partA) ? 1 : 0;
+    for (uint8_t size = 1; size <= maxMovesPartB_; ++size)
+        result += partBCounter_.count(size, partA);
+    return result;
+}
+
+uint64_t CommutatorFinder::numCandidates() const {
+    return numCandidates_;
+}
+
+uint64_t CommutatorFinder::numDoneCandidates() const {
+    if (searchesByTasks())
+        return numParallelDoneCandidates_;
+    uint64_t result = 0;
+    if (SearchMode::PartBFirst == mode_) {
+        // all partB before the current one are paired with every partA
+        for (uint8_t a = nextPartA(0); a < kNumAllQtmMoves; a = nextPartA(a + 1)) {
+            result += searchesParallelFirstPartB(a) ? 1 : 0;
+            for (uint8_t size = 1; size < partB_.size(); ++size)
+                result += partBCounter_.count(size, a);
+            result += partBCounter_.rank(partB_.get(), a);
+        }
+        return result;
+    }
+    for (uint8_t a = nextPartA(0); a < partA_; a = nextPartA(a + 1))
+        result += numPartBCandidates(a);
+    if (partA_ >= kNumAllQtmMoves)
+        return result;
+    result += searchesParallelFirstPartB(partA_) ? 1 : 0;
+    for (uint8_t size = 1; size < partB_.size(); ++size)
+        result += partBCounter_.count(size, partA_);
+    return result + partBCounter_.rank(partB_.get(), partA_);
+}
+
+std::string CommutatorFinder::checkpointPath() const {
+    return checkpointFilePath(outputPath_, shardIndex_, numShards_);
+}
+
+std::string checkpointFilePath(std::string_view outputPath, unsigned index, unsigned numShards) {
+    const bool toDir = !outputPath.empty() && '/' == outputPath.back();
+    const std::string path = std::string(outputPath) + (toDir ? "checkpoint.txt" : ".checkpoint");
+    return numShards > 1 ? shardFilePath(path, index, numShards) : path;
+}
+
+std::string CommutatorFinder::searchSettings() const {
+    // search order (incremental, partB-first or tasks) and everything that defines the results
+    const int order = searchesByTasks() ? 2 : (SearchMode::PartBFirst == mode_ ? 1 : 0);
+    return std::to_string(order) + " " + std::to_string(maxMovesPartB_) + " "
+            + std::to_string(useSymmetry_) + " " + std::to_string(shardIndex_) + " "
+            + std::to_string(numShards_) + " " + std::to_string(binaryOutput_) + " "
+            + std::to_string(relevantLayersOnly_) + " " + std::to_string(int(inertMoves_))
+            + (isRestricted(allowedMoves_) ? " " + ::toString(allowedMoves_) : "");
+}
+
+std::vector<std::string> CommutatorFinder::outputFilePaths() const {
+    std::vector<std::string> paths;
+    if (!outputToDir_)
+        return {pathToOutFile(CaseType::caseTypeEnd, 0)};
+    for (size_t i = 0; i < size_t(CaseType::caseTypeEnd); ++i)
+        for (uint8_t partBsize = 1; partBsize <= maxMovesPartB_; ++partBsize)
+            paths.push_back(pathToOutFile(static_cast<CaseType>(i), partBsize));
+    return paths;
+}
+
+bool CommutatorFinder::checkpointIfNeeded() {
+    if (stopRequested_)
+        return true;
+    if (now() - lastCheckpoint_ >= checkpointInterval_)
+        saveCheckpoint(false);
+    return false;
+}
+
+void CommutatorFinder::saveCheckpoint(bool finished) {
+    std::ostringstream oss;
+    oss << "settings " << searchSettings() << "\n"
+        << "finished " << finished << "\n"
+        << "partA " << int(partA_) << "\n"
+        << "partB";
+    for (uint8_t i = 0; i < partB_.size(); ++i)
+        oss << " " << int(partB_.get()[i]);
+    oss << "\ntasks ";
+    for (bool done: doneTasks_)
+        oss << done;
+    oss << "\nresults " << numResults_ << "\n";
+    writer_.flush(true);
+    // everything after these sizes is written after the checkpoint and will be truncated
+    for (const auto& path: outputFilePaths()) {
+        std::error_code error;
+        const auto size = std::filesystem::file_size(path, error);
+        oss << "file " << (error ? 0 : size) << " " << path << "\n";
+    }
+    // a complete checkpoint replaces the previous one, even if we're killed or the machine
+    // goes down while saving it: the tmp file is on disk before the rename
+    const std::string path = checkpointPath(), tmpPath = path + ".tmp", contents = oss.str();
+    bool saved = false;
+    if (FILE* file = std::fopen(tmpPath.c_str(), "wb")) {
+        saved = contents.size() == std::fwrite(contents.data(), 1, contents.size(), file)
+                && 0 == std::fflush(file) && 0 == fsync(fileno(file));
+        saved = 0 == std::fclose(file) && saved;
+    }
+    if (!saved || 0 != std::rename(tmpPath.c_str(), path.c_str()))
+        LOG(ERROR) << "failed to save checkpoint " << path;
+    lastCheckpoint_ = now();
+}
+
+void CommutatorFinder::removeCheckpoint() {
+    writer_.flush(true);
+    std::error_code error;
+    std::filesystem::remove(checkpointPath(), error);
+    LOG_IF(error, ERROR) << "failed to remove checkpoint " << checkpointPath();
+}
+
+bool CommutatorFinder::loadCheckpoint(bool& finished) {
+    const std::string path = checkpointPath();
+    std::istringstream contents(getFileContents(path, true));
+    std::string line, key;
+    std::vector<std::pair<std::string, uintmax_t>> fileSizes;
+    bool hasSettings = false;
+    while (std::getline(contents, line)) {
+        std::istringstream values(line);
+        values >> key;
+        if ("settings" == key) {
+            std::string settings;
+            std::getline(values >> std::ws, settings);
+            LOG_IF(settings != searchSettings(), FATAL) << "checkpoint " << path
+                    << " is of a different search: " << settings << " vs " << searchSettings();
+            hasSettings = true;
+        } else if ("finished" == key) {
+            values >> finished;
+        } else if ("partA" == key) {
+            int partA;
+            values >> partA;
+            partA_ = partA;
+        } else if ("partB" == key) {
+            MovesArray moves = emptyMovesArray();
+            for (int i = 0, move; i < kMaxScrambleLength && values >> move; ++i)
+                moves[i] = move;
+            partB_.set(moves);
+        } else if ("tasks" == key) {
+            std::string tasks;
+            values >> tasks;
+            doneTasks_.clear();
+            for (char done: tasks)
+                doneTasks_.push_back('1' == done);
+        } else if ("results" == key) {
+            uint64_t numResults;
+            values >> numResults;
+            numResults_ = numResults;
+            lastResultPartA_ = numResults;
+        } else if ("file" == key) {
+            uintmax_t size;
+            std::string file;
+            values >> size;
+            std::getline(values >> std::ws, file);
+            fileSizes.emplace_back(file, size);
+        }
+    }
+    if (!hasSettings) {
+        LOG(WARNING) << "no checkpoint " << path << " to resume from. Starting from scratch";
+        return false;
+    }
+    // drop results written after the checkpoint
+    writer_.closeFiles();
+    for (const auto& [file, size]: fileSizes) {
+        std::error_code error;
+        const auto actualSize = std::filesystem::file_size(file, error);
+        if (error) {
+            LOG_IF(size > 0, FATAL) << "output file " << file << " is missing";
+            continue;
+        }
+        LOG_IF(actualSize < size, FATAL) << "output file " << file << " is shorter than "
+                                         << "in checkpoint " << path;
+        std::filesystem::resize_file(file, size);
+    }
     lastLogging_ = now();
+    return true;
 }
@@ -3,9 +3,29 @@
 #include "incrementalscramble.h"
 #include "cubestate.h"
 #include "searchcriteria.h"
+#include "cubesymmetry.h"
+#include "resultwriter.h"
 
 #include <string>
 #include <chrono>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// order in which candidate commutators are generated
+enum class SearchMode {
+    Incremental, // partB from IncrementalScramble; results ordered by partA, then partB length
+    DepthFirst,  // partB built back to front, reusing B A' B' of its tail. Same set of results.
+                 // Subtrees are searched as tasks, which can be shared by threads and shards
+    PartBFirst,  // each partB is built once and paired with every partA. Same set of results
+};
+
+// results [A, B] where deleting a partB move doesn't change the state, e.g. M in [L, U2 M U R U]
+enum class InertMoves {
+    Keep, // saved as all other results
+    Tag,  // saved with kInertMoveTag after the commutator
+    Drop, // not saved
+};
 
 // Breadth-first searches through all possible commutators and saves search results to a file.
 // Commutator is [A, B] = A B A' B' where part A is a single move and part B size <= maxMovespartB
@@ -26,38 +46,228 @@ public:
     /// otherwise will be returned as a full sequence of space-separated moves
     std::string toString(bool commutatorNotation = true) const;
 
-    // reset partA, partB
+    // reset partA, partB and results count
     void reset();
 
+    void setSearchMode(SearchMode mode);
+
+    /// if @param useSymmetry is true, only one partA of each symmetry class is searched (6 of 45)
+    /// and results for the other partA are derived by mapping partB with the cube symmetries
+    void setUseSymmetry(bool useSymmetry);
+
+    /// with @param numThreads > 1, partB subtrees of the depth-first search are shared by
+    /// that many threads regardless of the search mode. Same set of results
+    void setNumThreads(unsigned numThreads);
+
+    /// search only shard #@param index (0-based) of @param numShards. Shards split the
+    /// depth-first subtrees deterministically, so that independent processes cover the whole
+    /// search. Results go to shardFilePath() of each output file; see commfinder-merge
+    void setShard(unsigned index, unsigned numShards);
+
+    /// if @param resume is true, find() continues from the checkpoint of the previous run
+    /// with the same output path and settings, if there is one. Results written after that
+    /// checkpoint are truncated. Checkpoints are saved periodically and when find() is
+    /// stopped. A finished search removes its checkpoint, except a shard, which keeps it for
+    /// mergeShards
+    void setResume(bool resume);
+
+    /// if @param relevantLayersOnly is true, algs with moves of layers that don't hold the
+    /// elements of their case (e.g. M in [L, U2 M U R U] for corners) are discarded. PartB
+    /// subtrees with moves irrelevant to all cases of the criteria are not searched at all
+    void setRelevantLayersOnly(bool relevantLayersOnly);
+
+    /// restricts partA and partB to @param moves, e.g. <R, U, r, u, M>. PartB subtrees with
+    /// other moves are not searched. Symmetry is not used with a restricted move set
+    void setAllowedMoves(const MoveSet& moves);
+
+    /// what to do with results that have an inert partB move, see InertMoves
+    void setInertMoves(InertMoves inertMoves);
+
+    /// if @param binaryOutput is true, results are saved as binary records (resultformat.h)
+    /// to .bin files instead of text lines. commfinder-export converts them to text
+    void setBinaryOutput(bool binaryOutput);
+
+    /// save checkpoints no more often than every @param interval
+    void setCheckpointInterval(std::chrono::seconds interval);
+
+    /// makes running find() save a checkpoint and return as soon as possible.
+    /// Safe to call from a signal handler
+    static void requestStop();
+
+    /// number of commutators [A, B] the last find() evaluates (symmetric images aren't counted)
+    uint64_t numCandidates() const;
+
+    /// number of commutators [A, B] evaluated so far; numCandidates() after a finished find()
+    uint64_t numDoneCandidates() const;
+
 private:
     uint8_t partA_;
     IncrementalScramble partB_;
     uint8_t maxMovesPartB_;
     SearchCriteria criteria_;
+    SearchMode mode_;
+    bool useSymmetry_;
+    unsigned numThreads_;
+    unsigned shardIndex_;
+    unsigned numShards_;
+    bool resume_;
+    bool binaryOutput_;
+    bool relevantLayersOnly_;
+    InertMoves inertMoves_;
+
+    // moves of partA and partB, see setAllowedMoves
+    MoveSet allowedMoves_;
+
+    // allowed moves relevant to any case of criteria_ (all allowed without relevantLayersOnly_)
+    MoveSet relevantMoves_;
+    bool restrictsMoves_; // some move is not in relevantMoves_
+    // counts partB candidates of relevantMoves_ only, for progress and ETA
+    ScrambleCounter partBCounter_;
+    void updateRelevantMoves();
+
+    // moves relevant to each case type, see ::relevantMoves()
+    std::array<std::array<bool, kNumAllQtmMoves>, size_t(CaseType::caseTypeEnd)> caseMoves_;
+
+    // skips partB_ subtrees with irrelevant or not allowed moves; parallel moves are skipped like
+    // IncrementalScramble::skipSubtree(i, @param parallelTo) does
+    void skipIrrelevantPartB(uint8_t parallelTo);
+    std::chrono::seconds checkpointInterval_;
+    std::chrono::time_point<std::chrono::steady_clock> lastCheckpoint_;
+    static std::atomic<bool> stopRequested_;
+
+    // doneTasks_[i] is true if task #i of findByTasks is done
+    std::vector<bool> doneTasks_;
+
+    // searchedPartA_[a] is false if partA = a is derived from its symmetry representative
+    std::array<bool, kNumAllQtmMoves> searchedPartA_;
+
+    // images of each searched partA under symmetries: (partA, symmetry mapping it there)
+    std::array<std::vector<std::pair<uint8_t, const MoveMap*>>, kNumAllQtmMoves> partAImages_;
+
+    // @returns first searched (and relevant) partA >= @param partA or kNumAllQtmMoves if there
+    // are none
+    uint8_t nextPartA(uint8_t partA) const;
 
     // either a .txt file path or directory path
     std::string outputPath_;
 
     // total number of results
-    uint64_t numResults_;
+    std::atomic<uint64_t> numResults_;
+
+    // appends results of all threads to output files
+    ResultWriter writer_;
 
     // if true, each result will be saved in separate file
     bool outputToDir_;
 
-    // return path to output file to output special cases
-    std::string pathToOutFile(CaseType ct) const;
+    // SearchMode::Incremental loop
+    void findIncremental();
+
+    // SearchMode::PartBFirst: for each partB, evaluates all partA
+    void findPartBFirst();
+
+    // depth-first search of shardIndex_ subtrees by numThreads_ threads
+    // @param resumed - if true, doneTasks_ are skipped
+    void findByTasks(bool resumed);
+
+    // results of a running task of findByTasks: (output file, line or binary record). They go
+    // to writer_ when the task is done, so output files only have results of done tasks
+    using TaskResults = std::vector<std::pair<std::string, std::string>>;
+
+    // true if search is split to tasks: depth-first, in several threads or shards
+    bool searchesByTasks() const {
+        return SearchMode::DepthFirst == mode_ || numThreads_ > 1 || numShards_ > 1;
+    }
+
+    /// evaluates [@param partA, B] for all partB that end with the @param depth moves in
+    /// @param moves (stored back to front), unless a stop is requested
+    /// @param conjugate - state of T A' T' where T are these moves
+    /// @param results - found results are added there
+    void searchDepthFirst(uint8_t partA, MovesArray& moves, uint8_t depth
+                          , const CubeState& conjugate, TaskResults& results);
+
+    // same as searchDepthFirst, but only for partB with move #depth (from the end) = @param x
+    void searchDepthFirstFrom(uint8_t partA, MovesArray& moves, uint8_t depth, uint8_t x
+                              , const CubeState& conjugate, TaskResults& results);
+
+
+    // return path to output file to output special cases found with @param partBsize moves
+    // (the only output file if results aren't saved to a directory)
+    std::string pathToOutFile(CaseType ct, uint8_t partBsize) const;
+
+    // checks if output files(s) are available; creates/clears them
+    void prepareOutputFiles();
+
+    // @returns path to the checkpoint file of this search
+    std::string checkpointPath() const;
+
+    // @returns settings of the search that should match to resume from a checkpoint
+    std::string searchSettings() const;
+
+    // @returns paths of all output files
+    std::vector<std::string> outputFilePaths() const;
+
+    // saves a checkpoint if it's time to. Everything before partA_, partB_ should be done
+    // @returns true if the search should stop
+    bool checkpointIfNeeded();
+
+    // saves search position, results count and sizes of output files to checkpointPath()
+    void saveCheckpoint(bool finished);
+
+    // removes the checkpoint of a finished search, after its results are on disk
+    void removeCheckpoint();
+
+    // restores search position and truncates output files to sizes from checkpoint
+    // @param finished - set to true if the checkpointed search was finished
+    // @returns false if there's no checkpoint
+    bool loadCheckpoint(bool& finished);
 
     // prints message of finished search
     void printFinishMessage() const;
 
-    // prints message of finished all partB algs for current partA
-    void printPartAdoneMessage() const;
+    // prints message of finished all partB algs for @param partA
+    void printPartAdoneMessage(uint8_t partA) const;
 
     // prints progress message if, but no more than once in N seconds
     void printOccasionalProgressReport() const;
 
-    // found commutator result => save to file and increment numResults
-    void onFoundResult(CaseType caseType, CubeState& cube);
+    // @returns number of partB searched with @param partA
+    uint64_t numPartBCandidates(uint8_t partA) const;
+
+    // number of commutators [A, B] the search evaluates (symmetric images aren't counted)
+    uint64_t numCandidates_ = 0;
+
+    // number of commutators evaluated by finished tasks of findByTasks
+    std::atomic<uint64_t> numParallelDoneCandidates_ = 0;
+
+    // numDoneCandidates() when this find() started, for rate and ETA
+    uint64_t numDoneCandidatesAtStart_ = 0;
+
+    // beginning of the search, for rate and ETA
+    std::chrono::time_point<std::chrono::steady_clock> startTime_;
+
+    // evaluates [partA, L] if partA is parallel to L: the only partB parallel to partA searched
+    void evaluateParallelFirstPartB(uint8_t partA);
+
+    // @returns true if [@param partA, L] is evaluated although L is parallel to partA
+    bool searchesParallelFirstPartB(uint8_t partA) const;
+
+    // classifies the commutator [partA, partB] in state @param cube, saves it if interesting.
+    // Results are written right away or, if @param results isn't nullptr, added there
+    void evaluate(CubeState& cube, uint8_t partA, const MovesArray& partB
+                  , TaskResults* results = nullptr);
+
+    // found [searchedPartA, partB] is interesting => evaluate its images under symmetries
+    void evaluateSymmetricImages(uint8_t searchedPartA, const MovesArray& partB
+                                 , TaskResults* results);
+
+    // found commutator result => save to file and increment numResults (or add it to
+    // @param results, see evaluate)
+    void onFoundResult(CaseType caseType, CubeState& cube, uint8_t partA, const MovesArray& partB
+                       , TaskResults* results);
+
+    // writes results of a done task and counts them
+    void writeTaskResults(TaskResults& results);
 
     // last time we printed non-critical logging message. This us for occasional progress only
     mutable std::chrono::time_point<std::chrono::steady_clock> lastLogging_;
@@ -66,5 +276,36 @@ private:
     mutable uint64_t lastResultPartA_;
 };
 
+/// @returns [A, B] or, if @param commutatorNotation is false, full sequence A B A' B'
+std::string commutatorToString(uint8_t partA, const MovesArray& partB
+                               , bool commutatorNotation = true);
+
+/// @returns index of a move of @param partB that can be deleted from [@param partA, @param partB]
+/// without changing its @param state, or kNoMove if every move matters. Centers are compared
+/// only if @param compareCenters
+uint8_t findInertMove(uint8_t partA, const MovesArray& partB, const CubeState& state
+                      , bool compareCenters = true);
+
+/// @returns path to the file of @param ct results with @param partBsize moves in
+/// @param outputDir ("/path/to/outputdir/"); .bin file if @param binary is true, .txt otherwise
+std::string resultsFilePath(std::string_view outputDir, CaseType ct, uint8_t partBsize
+                            , bool binary = false);
+
+/// @returns path to the part of results file @param path written by shard @param index
+std::string shardFilePath(std::string_view path, unsigned index, unsigned numShards);
+
+/// @returns path to the checkpoint of a search with output to @param outputPath, of shard
+/// @param index of @param numShards
+std::string checkpointFilePath(std::string_view outputPath, unsigned index = 0
+                               , unsigned numShards = 1);
+
+/// merges results of all @param numShards shards of a search with output to @param outputPath
+/// (file or directory, as in CommutatorFinder) and @param maxMovesPartB. Every shard should be
+/// finished: its checkpoint says so and its files have the sizes the checkpoint records.
+/// Shard files and checkpoints are removed afterwards only if @param deleteInputs
+/// @returns number of merged results (lines or binary records) or -1 if a shard is missing,
+/// unfinished or broken. Nothing is merged unless all shards are finished
+int64_t mergeShards(std::string_view outputPath, uint8_t maxMovesPartB, unsigned numShards
+                    , bool binary, bool deleteInputs);
 
 #endif // COMMUTATORFINDER_H
@@ -8,6 +8,55 @@ MovesArray emptyMovesArray() {
     return e;
 }
 
+uint8_t numMoves(const MovesArray& moves) {
+    return std::find(moves.begin(), moves.end(), kNoMove) - moves.begin();
+}
+
+MoveSet allMoves() {
+    MoveSet all;
+    all.fill(true);
+    return all;
+}
+
+bool isRestricted(const MoveSet& moves) {
+    return std::find(moves.begin(), moves.end(), false) != moves.end();
+}
+
+bool stringToMoveSet(const std::string& generators, MoveSet& moves) {
+    moves.fill(false);
+    std::string normalized = generators;
+    for (char& c: normalized)
+        if (',' == c || '<' == c || '>' == c)
+            c = ' ';
+    for (const std::string& generator: splitString(normalized, ' ')) {
+        if (generator.empty())
+            continue;
+        const uint8_t move = stringToMove(generator);
+        if (kNoMove == move)
+            return false;
+        for (uint8_t m = move; m < kNumAllQtmMoves; m += kNumQtmClockwiseMoves)
+            if (1 == generator.size() || m == move)
+                moves[m] = true;
+    }
+    return std::find(moves.begin(), moves.end(), true) != moves.end();
+}
+
+std::string toString(const MoveSet& moves) {
+    std::string result;
+    for (uint8_t layer = 0; layer < kNumQtmClockwiseMoves; ++layer) {
+        const uint8_t variants[] = {layer, uint8_t(layer + kNumQtmClockwiseMoves)
+                                    , uint8_t(layer + 2 * kNumQtmClockwiseMoves)};
+        if (moves[variants[0]] && moves[variants[1]] && moves[variants[2]]) {
+            result += (result.empty() ? "" : ",") + std::string(1, kCubeMovesChars[layer]);
+            continue;
+        }
+        for (uint8_t m: variants)
+            if (moves[m])
+                result += (result.empty() ? "" : ",") + moveToString(m);
+    }
+    return result;
+}
+
 std::string moveToString(uint8_t moveIndex) {
     if (moveIndex == kNoMove || moveIndex >= kNumAllQtmMoves) {
         LOG(ERROR) << "tried to convert move #" << int(moveIndex) << " to string";
@@ -30,6 +79,13 @@ std::string toString(const MovesArray &moves) {
     return result;
 }
 
+std::string toString(const MoveSequence& moves) {
+    std::string result;
+    for (size_t i = 0; i < moves.size(); ++i)
+        result += (i?" ":"") + moveToString(moves[i]);
+    return result;
+}
+
 MovesArray stringToMoves(const std::string& scramble) {
     // TODO replace apostrophesChars =  "ʼ᾿՚’`";
     StringVec strMoves = splitString(scramble, ' ');
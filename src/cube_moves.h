@@ -31,6 +31,23 @@ constexpr uint8_t kNumElemStickers = 4 * kNumSides;
 using StickersArray = std::array<uint8_t, kNumElemStickers>;
 using CapsArray = std::array<uint8_t, kNumSides>;
 
+// number of element arrays in a cube state: corners, edges, x-centers, t-centers, wings, caps
+constexpr uint8_t kNumOrbits = 6;
+
+// fully expanded effect of a single move, one destination map per orbit in the order above:
+// after the move, orbit[i] = orbitBeforeTheMove[map[i]]. Caps map only uses first kNumSides bytes
+using MovePermutation = std::array<StickersArray, kNumOrbits>;
+
+// max number of stickers any single move relocates within each orbit
+constexpr std::array<uint8_t, kNumOrbits> kMaxMovedStickers = {12, 8, 8, 8, 8, 4};
+constexpr uint8_t kMaxMovedStickersPerOrbit = 12;
+
+// MovePermutation compacted to the stickers that actually move: orbit[to[k]] = before[from[k]].
+// Unused entries are no-op (i <- i), so every move costs the same fixed number of gathers
+struct MovedStickers {
+    std::array<std::array<uint8_t, kMaxMovedStickersPerOrbit>, kNumOrbits> to, from;
+};
+
 // max.scramble length used in: iterative scramble; bruteforce solver
 constexpr uint8_t kMaxScrambleLength = 10;
 using MovesArray = std::array<uint8_t, kMaxScrambleLength>;
@@ -38,6 +55,29 @@ using MovesArray = std::array<uint8_t, kMaxScrambleLength>;
 // returns {-1,-1,-1...}
 MovesArray emptyMovesArray();
 
+// returns number of moves before the first kNoMove
+uint8_t numMoves(const MovesArray& moves);
+
+// moves of any length, e.g. solutions longer than kMaxScrambleLength
+using MoveSequence = std::vector<uint8_t>;
+
+// generators of searches and solutions: moves[m] is true if move m may be used
+using MoveSet = std::array<bool, kNumAllQtmMoves>;
+
+// returns set of all moves
+MoveSet allMoves();
+
+// returns true if some move is not in @param moves
+bool isRestricted(const MoveSet& moves);
+
+// parses generators, e.g. "R,U,r,u,M" or "<R, U2>". A layer letter stands for its quarter,
+// double and prime moves; "U2" or "U'" is that move only. Returns false on unknown generator.
+// Wide moves (Rw) are unknown: a set holds single-layer moves, and <R, r> isn't <Rw>
+bool stringToMoveSet(const std::string& generators, MoveSet& moves);
+
+// returns generators of @param moves in the format of stringToMoveSet, e.g. "R,U2,U'"
+std::string toString(const MoveSet& moves);
+
 using StringVec = std::vector<std::string>;
 
 // returns true if e.g.
@@ -61,6 +101,13 @@ inline uint8_t oppoMove(uint8_t move) {
 // examples: [u', D], [S, F2] are parallel; [u, f] are not
 bool areParallelLayersMoves(uint8_t m1, uint8_t m2);
 
+// returns true if move @param next may directly follow @param prev in a non-redundant scramble:
+// moves are of different faces and parallel moves go in ascending order ("R L" -> "L R")
+inline bool canFollow(uint8_t prev, uint8_t next) {
+    return !areMovesOfSameFace(prev, next)
+            && (!areParallelLayersMoves(prev, next) || baseMove(prev) < baseMove(next));
+}
+
 // returns true if m is outer layer move (LURDFB)
 inline bool isOuterMove(uint8_t m) {
     // see if baseMove is on first 6 positions in string "LURDFBlurdfbMES"
@@ -74,6 +121,7 @@ std::string moveToString(uint8_t moveIndex);
 
 // convert uint8 move to human-readable string
 std::string toString(const MovesArray& moves);
+std::string toString(const MoveSequence& moves);
 
 // convert string to single move. Returns kNoMove if invalid
 uint8_t stringToMove(const std::string& str);
@@ -2,6 +2,8 @@
 #include "easylogging++.h"
 #include "helpers.h"
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
 
 /*
   Here are the configuration/indeces of the 5x5 cube pieces in corresponding arrays:
@@ -61,22 +63,104 @@ StickersArray CubeState::tCentersStateInitial = {0,1,2,3,4,5,6,7,8,9,10,11,12,13
 StickersArray CubeState::wingsStateInitial =    {0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23};
 CapsArray CubeState::capsStateInitial =         {0,1,2,3,4,5};
 
-bool areXcenterSafe(const StickersArray& xCentersCfg) {
-    constexpr std::string_view xCentersSides = "flulbubrurfufdlldbbdrrdf";
-    for (uint8_t i = 0; i < xCentersCfg.size(); ++i) {
-        if (xCentersSides[i] != xCentersSides[xCentersCfg[i]])
-            return false;
+const std::array<MovePermutation, kNumAllQtmMoves> CubeState::movePermutations_
+                = CubeState::generateMovePermutations();
+alignas(kOrbitSlotSize) const std::array<OrbitSlots, kNumAllQtmMoves> CubeState::moveShuffles_
+                = CubeState::generateMoveShuffles();
+const std::array<MovedStickers, kNumAllQtmMoves> CubeState::movedStickers_
+                = CubeState::generateMovedStickers();
+
+const std::array<CubeState, kNumAllQtmMoves> CubeState::moveStates_
+                = CubeState::generateMoveStates();
+
+// kernel of this CPU. Static tables of this and other translation units apply moves and compare
+// stickers during their dynamic initialization, so it's chosen on first use rather than by a
+// namespace-scope static that may not be initialized yet
+static inline const OrbitKernel& orbitKernel() {
+    static const OrbitKernel& kernel = bestOrbitKernel();
+    return kernel;
+}
+
+// stickers of all orbits packed into 64-bit words for hash(): 3 words per orbit, caps in one
+constexpr uint8_t kWordsPerOrbit = kNumElemStickers / sizeof(uint64_t);
+constexpr uint8_t kNumHashWords = (kNumOrbits - 1) * kWordsPerOrbit + 1;
+static_assert(kNumElemStickers % sizeof(uint64_t) == 0 && kNumSides <= sizeof(uint64_t)
+              && kNumHashWords % 2 == 0, "hash() packs orbits into pairs of 64-bit words");
+
+// one seed per hash word, splitmix64 sequence
+using HashSeeds = std::array<uint64_t, kNumHashWords>;
+static constexpr HashSeeds generateHashSeeds() {
+    HashSeeds seeds{};
+    uint64_t x = 0x5eed;
+    for (auto& seed: seeds) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        seed = z ^ (z >> 31);
     }
-    return true;
+    return seeds;
 }
+static constexpr HashSeeds hashSeeds = generateHashSeeds();
 
-bool areTcenterSafe(const StickersArray& tCentersCfg) {
-    constexpr std::string_view tCentersSides = "ufulurubdfdldrdbflfrblbr";
-    for (uint8_t i = 0; i < tCentersCfg.size(); ++i) {
-        if (tCentersSides[i] != tCentersSides[tCentersCfg[i]])
-            return false;
-    }
-    return true;
+// 128-bit product folded to 64 bits (as in wyhash): every bit depends on all bits of a and b
+static inline uint64_t foldedMultiply(uint64_t a, uint64_t b) {
+    const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return uint64_t(product) ^ uint64_t(product >> 64);
+}
+
+// comparisons of orbitKernel(); even scalar ones beat per-byte loops with modulo arithmetic
+static inline uint32_t orbitMismatches(const uint8_t* slot) {
+    return orbitKernel().mismatches(slot);
+}
+
+static inline uint32_t orbitClassMismatches(const uint8_t* slot, const uint8_t* table) {
+    return orbitKernel().classMismatches(slot, table);
+}
+
+// bits of orbitMismatches/orbitClassMismatches that belong to the orbit
+constexpr uint32_t kStickersBits = (uint32_t(1) << kNumElemStickers) - 1;
+constexpr uint32_t kCapsBits = (uint32_t(1) << kNumSides) - 1;
+
+using SlotTable = std::array<uint8_t, kOrbitSlotSize>;
+
+// sticker class is the piece: stickers [0, groupSize) are piece #0 etc.
+static constexpr SlotTable pieceTable(uint8_t groupSize) {
+    SlotTable table{};
+    for (uint8_t i = 0; i < kOrbitSlotSize; ++i)
+        table[i] = i / groupSize;
+    return table;
+}
+
+// sticker class is the side it's located on, one char per sticker
+static constexpr SlotTable sideTable(std::string_view sides) {
+    SlotTable table{};
+    for (uint8_t i = 0; i < sides.size(); ++i)
+        table[i] = sides[i];
+    return table;
+}
+
+static constexpr SlotTable kCornerPieces = pieceTable(3);
+static constexpr SlotTable kEdgePieces = pieceTable(2);
+static constexpr SlotTable kXcenterSides = sideTable("flulbubrurfufdlldbbdrrdf");
+static constexpr SlotTable kTcenterSides = sideTable("ufulurubdfdldrdbflfrblbr");
+
+// number of stickers out of place. @param slot points to orbit slot (kOrbitSlotSize bytes)
+static inline uint8_t slotMismatches(const uint8_t* slot, uint32_t orbitBits = kStickersBits) {
+    return __builtin_popcount(orbitMismatches(slot) & orbitBits);
+}
+
+// areGroupedByButNotSorted for orbit slot, groups are classes of @param table
+static inline bool slotGroupedButNotSorted(const uint8_t* slot, const SlotTable& table) {
+    return 0 == (orbitClassMismatches(slot, table.data()) & kStickersBits)
+        && 0 != (orbitMismatches(slot) & kStickersBits);
+}
+
+// hasGroupedByButNotSorted for orbit slot, groups are classes of @param table
+static inline bool slotHasGroupedButNotSorted(const uint8_t* slot, const SlotTable& table
+                                              , uint8_t groupSize) {
+    // sticker stays within its piece, but not on its place
+    const uint32_t moved = ~orbitClassMismatches(slot, table.data()) & orbitMismatches(slot);
+    return hasFullBitGroup(moved, groupSize, kNumElemStickers);
 }
 
 uint8_t edgeStickerNextIndex(uint8_t index) {
@@ -191,15 +275,15 @@ void CubeState::performEdgesCycle(const std::vector<uint8_t>& cycle, uint8_t pri
 
 CaseType CubeState::getCaseType(const SearchCriteria &criteria) const {
     // if caps aren't in place, that's not interesting
-    if (!std::is_sorted(capsState_.begin(), capsState_.end()))
+    if (0 != slotMismatches(capsState_.data(), kCapsBits))
         return CaseType::caseTypeEnd;
-    uint8_t mw = numMismatches(wingsState_, wingsStateInitial);
+    uint8_t mw = slotMismatches(wingsState_.data());
     if (mw > 5)
         return CaseType::caseTypeEnd; // saves a few computations right off
-    uint8_t me = numMismatches(edgesState_, edgesStateInitial);
-    uint8_t mc = numMismatches(cornersState_, cornersStateInitial);
-    uint8_t mx = numMismatches(xCentersState_, xCentersStateInitial);
-    uint8_t mt = numMismatches(tCentersState_, tCentersStateInitial);
+    uint8_t me = slotMismatches(edgesState_.data());
+    uint8_t mc = slotMismatches(cornersState_.data());
+    uint8_t mx = slotMismatches(xCentersState_.data());
+    uint8_t mt = slotMismatches(tCentersState_.data());
     bool eSolved = (0 == me);
     bool cSolved = (0 == mc);
     bool xSolved = (0 == mx);
@@ -353,7 +437,131 @@ CubeState& CubeState::applyScramble(const MovesArray& moves) {
     return *this;
 }
 
+// gathers the stickers that move: state[to[k]] = state before the move[from[k]]
+template <uint8_t ORBIT, std::size_t SIZE>
+inline void moveStickers(std::array<uint8_t, SIZE>& state, const MovedStickers& m) {
+    const std::array<uint8_t, SIZE> before = state;
+    for (uint8_t k = 0; k < kMaxMovedStickers[ORBIT]; ++k)
+        state[m.to[ORBIT][k]] = before[m.from[ORBIT][k]];
+}
+
+std::array<MovePermutation, kNumAllQtmMoves> CubeState::generateMovePermutations() {
+    std::array<MovePermutation, kNumAllQtmMoves> result;
+    for (uint8_t move = 0; move < kNumAllQtmMoves; ++move) {
+        // solved state holds identity in every orbit, so the state after the move is its map
+        CubeState cube;
+        cube.applyScrambleMoveByCycles(move);
+        MovePermutation& p = result[move];
+        p[0] = cube.cornersState_;
+        p[1] = cube.edgesState_;
+        p[2] = cube.xCentersState_;
+        p[3] = cube.tCentersState_;
+        p[4] = cube.wingsState_;
+        for (uint8_t i = 0; i < kNumElemStickers; ++i)
+            p[5][i] = (i < kNumSides) ? cube.capsState_[i] : i;
+    }
+    return result;
+}
+
+std::array<MovedStickers, kNumAllQtmMoves> CubeState::generateMovedStickers() {
+    std::array<MovedStickers, kNumAllQtmMoves> result;
+    for (uint8_t move = 0; move < kNumAllQtmMoves; ++move) {
+        for (uint8_t orbit = 0; orbit < kNumOrbits; ++orbit) {
+            const StickersArray& map = movePermutations_[move][orbit];
+            auto& to = result[move].to[orbit];
+            auto& from = result[move].from[orbit];
+            // no-op entries (0 <- 0) go first so that they never overwrite a moved sticker
+            std::fill(to.begin(), to.end(), 0);
+            std::fill(from.begin(), from.end(), 0);
+            // any orbit's initial state is the identity map
+            const uint8_t numMoved = numMismatches(map, cornersStateInitial);
+            LOG_IF(numMoved > kMaxMovedStickers[orbit], FATAL) << "move " << moveToString(move)
+                    << " relocates more than " << int(kMaxMovedStickers[orbit])
+                    << " stickers of orbit #" << int(orbit);
+            uint8_t k = kMaxMovedStickers[orbit] - numMoved;
+            for (uint8_t i = 0; i < kNumElemStickers; ++i) {
+                if (map[i] != i) {
+                    to[k] = i;
+                    from[k++] = map[i];
+                }
+            }
+        }
+    }
+    return result;
+}
+
+std::array<OrbitSlots, kNumAllQtmMoves> CubeState::generateMoveShuffles() {
+    std::array<OrbitSlots, kNumAllQtmMoves> result;
+    for (uint8_t move = 0; move < kNumAllQtmMoves; ++move)
+        result[move] = toOrbitSlots(movePermutations_[move]);
+    return result;
+}
+
+uint8_t* CubeState::orbitSlots() {
+    static_assert(offsetof(CubeState, edgesState_) == offsetof(CubeState, cornersState_) + 1*kOrbitSlotSize
+               && offsetof(CubeState, xCentersState_) == offsetof(CubeState, cornersState_) + 2*kOrbitSlotSize
+               && offsetof(CubeState, tCentersState_) == offsetof(CubeState, cornersState_) + 3*kOrbitSlotSize
+               && offsetof(CubeState, wingsState_) == offsetof(CubeState, cornersState_) + 4*kOrbitSlotSize
+               && offsetof(CubeState, capsState_) == offsetof(CubeState, cornersState_) + 5*kOrbitSlotSize
+               && sizeof(CubeState) == offsetof(CubeState, cornersState_) + kNumOrbits*kOrbitSlotSize,
+                  "CubeState orbits must be laid out as consecutive orbit slots");
+    return reinterpret_cast<uint8_t*>(this) + offsetof(CubeState, cornersState_);
+}
+
+const uint8_t* CubeState::orbitSlots() const {
+    return const_cast<CubeState*>(this)->orbitSlots();
+}
+
+const MovePermutation& CubeState::movePermutation(uint8_t move) {
+    return movePermutations_[move];
+}
+
+std::array<CubeState, kNumAllQtmMoves> CubeState::generateMoveStates() {
+    // solved state is the identity, so a single move state is its permutation
+    std::array<CubeState, kNumAllQtmMoves> result;
+    for (uint8_t move = 0; move < kNumAllQtmMoves; ++move) {
+        const MovePermutation& p = movePermutations_[move];
+        CubeState& cube = result[move];
+        cube.cornersState_ = p[0];
+        cube.edgesState_ = p[1];
+        cube.xCentersState_ = p[2];
+        cube.tCentersState_ = p[3];
+        cube.wingsState_ = p[4];
+        std::copy(p[5].begin(), p[5].begin() + kNumSides, cube.capsState_.begin());
+        cube.centersAreSafe_ = isOuterMove(move) ? Yes : No;
+    }
+    return result;
+}
+
+const CubeState& CubeState::moveState(uint8_t move) {
+    return moveStates_[move];
+}
+
 void CubeState::applyScrambleMove(uint8_t move) {
+    LOG_IF(kNoMove == move, FATAL) << "trying to apply scramble move -1";
+    // a vectorized kernel shuffles whole orbit slots; without one, moves only touch the
+    // stickers they relocate
+    const OrbitKernel& kernel = orbitKernel();
+    if (kernel.vectorized) {
+        kernel.gather(orbitSlots(), moveShuffles_[move][0].data());
+    } else {
+        const MovedStickers& m = movedStickers_[move];
+        moveStickers<0>(cornersState_, m);
+        moveStickers<1>(edgesState_, m);
+        moveStickers<2>(xCentersState_, m);
+        moveStickers<3>(tCentersState_, m);
+        moveStickers<4>(wingsState_, m);
+        moveStickers<5>(capsState_, m);
+    }
+
+    // effect on centers being safe
+    if (!isOuterMove(move)) {
+        // inner move destroys centers, but if they were destroyed, then Idk
+        centersAreSafe_ = (Yes == centersAreSafe_) ? No : Idk;
+    }
+}
+
+void CubeState::applyScrambleMoveByCycles(uint8_t move) {
     LOG_IF(kNoMove == move, FATAL) << "trying to apply scramble move -1";
     uint8_t prime = move / kNumQtmClockwiseMoves; // 0: qtm; 1: double; 2: prime
     // baseMove
@@ -385,24 +593,24 @@ bool CubeState::centersAreSafe() const {
 bool CubeState::centersAreSolved() const {
     if (No == centersAreSafe_)
         return false;
-    return std::is_sorted(xCentersState_.begin(), xCentersState_.end())
-        && std::is_sorted(tCentersState_.begin(), tCentersState_.end());
+    return 0 == slotMismatches(xCentersState_.data())
+        && 0 == slotMismatches(tCentersState_.data());
 }
 
 bool CubeState::cornersTwistedAndSolved() const {
-    return areGroupedByButNotSorted(3, cornersState_);
+    return slotGroupedButNotSorted(cornersState_.data(), kCornerPieces);
 }
 
 bool CubeState::hasCornerTwists() const {
-    return hasGroupedByButNotSorted(3, cornersState_);
+    return slotHasGroupedButNotSorted(cornersState_.data(), kCornerPieces, 3);
 }
 
 bool CubeState::edgesFlippedAndSolved() const {
-    return areGroupedByButNotSorted(2, edgesState_);
+    return slotGroupedButNotSorted(edgesState_.data(), kEdgePieces);
 }
 
 bool CubeState::hasEdgeFlips() const {
-    return hasGroupedByButNotSorted(2, edgesState_);
+    return slotHasGroupedButNotSorted(edgesState_.data(), kEdgePieces, 2);
 }
 
 CubeState& CubeState::reset() {
@@ -421,9 +629,9 @@ CubeState &CubeState::resetCenters() {
 }
 
 bool CubeState::isSolved() const {
-    return std::is_sorted(cornersState_.begin(), cornersState_.end())
-        && std::is_sorted(edgesState_.begin(), edgesState_.end())
-        && std::is_sorted(wingsState_.begin(), wingsState_.end())
+    return 0 == slotMismatches(cornersState_.data())
+        && 0 == slotMismatches(edgesState_.data())
+        && 0 == slotMismatches(wingsState_.data())
         && centersAreSolved();
 }
 
@@ -518,19 +726,112 @@ std::ostream& operator<<(std::ostream& oss, const CubeState& cube) {
     return oss << cube.toString();
 }
 
+CubeState compose(const CubeState& x, const CubeState& y) {
+    // y's orbits are x's destination maps: result[i] = x[y[i]]
+    CubeState result = x;
+    orbitKernel().gather(result.orbitSlots(), y.orbitSlots());
+    // sticker stays on its side under both x and y => it does under x y. Otherwise recalculate
+    result.centersAreSafe_ = (CubeState::Yes == x.centersAreSafe_ && CubeState::Yes == y.centersAreSafe_)
+            ? CubeState::Yes : CubeState::Idk;
+    return result;
+}
+
+template <std::size_t SIZE>
+inline void invertOrbit(std::array<uint8_t, SIZE>& inv, const std::array<uint8_t, SIZE>& state) {
+    for (uint8_t i = 0; i < SIZE; ++i)
+        inv[state[i]] = i;
+}
+
+CubeState inverse(const CubeState& x) {
+    CubeState result;
+    invertOrbit(result.cornersState_, x.cornersState_);
+    invertOrbit(result.edgesState_, x.edgesState_);
+    invertOrbit(result.xCentersState_, x.xCentersState_);
+    invertOrbit(result.tCentersState_, x.tCentersState_);
+    invertOrbit(result.wingsState_, x.wingsState_);
+    invertOrbit(result.capsState_, x.capsState_);
+    // inverse moves every sticker back within the same side
+    result.centersAreSafe_ = x.centersAreSafe_;
+    return result;
+}
+
+CubeState conjugate(const CubeState& x, const CubeState& by) {
+    return compose(compose(by, x), inverse(by));
+}
+
+CubeState commutator(const CubeState& x, const CubeState& y) {
+    return compose(compose(compose(x, y), inverse(x)), inverse(y));
+}
+
+StringVec pieceStickers(std::string_view sticker) {
+    // stickers of a piece are consecutive, in the same rotation for all pieces: moves map the
+    // next sticker of a piece to the next sticker of its destination
+    for (const auto& [config, numStickers]: {std::pair{&cornersConfig, 3}, {&edgesConfig, 2}}) {
+        const auto itr = std::find(config->begin(), config->end(), sticker);
+        if (config->end() == itr)
+            continue;
+        const int i = int(itr - config->begin());
+        StringVec result;
+        for (int t = 0; t < numStickers; ++t)
+            result.push_back((*config)[i / numStickers * numStickers + (i + t) % numStickers]);
+        return result;
+    }
+    const std::initializer_list<const StringVec*> oneStickerConfigs = {
+            &xCentersConfig, &tCentersConfig, &wingsConfig, &capsConfig};
+    for (const StringVec* config: oneStickerConfigs)
+        if (std::find(config->begin(), config->end(), sticker) != config->end())
+            return {std::string(sticker)};
+    return {};
+}
+
 uint16_t CubeState::totalNumMismatches() const {
     return
-        numMismatches(cornersState_, cornersStateInitial) +
-        numMismatches(capsState_, capsStateInitial) +
-        numMismatches(xCentersState_, xCentersStateInitial) +
-        numMismatches(tCentersState_, tCentersStateInitial) +
-        numMismatches(edgesState_, edgesStateInitial) +
-            numMismatches(wingsState_, wingsStateInitial);
+        slotMismatches(cornersState_.data()) +
+        slotMismatches(capsState_.data(), kCapsBits) +
+        slotMismatches(xCentersState_.data()) +
+        slotMismatches(tCentersState_.data()) +
+        slotMismatches(edgesState_.data()) +
+            slotMismatches(wingsState_.data());
+}
+
+// @returns word #@param i of the stickers in @param slots, see kNumHashWords. Padding bytes of
+// the orbit slots are never initialized, so they are masked out
+static inline uint64_t hashWord(const uint8_t* slots, uint8_t i) {
+    uint64_t word;
+    std::memcpy(&word, slots + i / kWordsPerOrbit * kOrbitSlotSize
+                + i % kWordsPerOrbit * sizeof(uint64_t), sizeof(word));
+    return (kNumHashWords - 1 == i) ? word & ((uint64_t(1) << (8 * kNumSides)) - 1) : word;
+}
+
+uint64_t CubeState::hash() const {
+    // independent multiplications of word pairs, no dependency chain between them
+    const uint8_t* slots = orbitSlots();
+    uint64_t h = 0;
+#pragma GCC unroll 8 // word offsets become constants
+    for (uint8_t i = 0; i < kNumHashWords; i += 2)
+        h ^= foldedMultiply(hashWord(slots, i) ^ hashSeeds[i]
+                            , hashWord(slots, i + 1) ^ hashSeeds[i + 1]);
+    return h;
+}
+
+bool CubeState::operator==(const CubeState& other) const {
+    return cornersState_ == other.cornersState_
+        && edgesState_ == other.edgesState_
+        && wingsState_ == other.wingsState_
+        && xCentersState_ == other.xCentersState_
+        && tCentersState_ == other.tCentersState_
+        && capsState_ == other.capsState_;
+}
+
+bool CubeState::operator!=(const CubeState& other) const {
+    return !(*this == other);
 }
 
 void CubeState::reCalculateIfCentersAreSafe() const {
-    bool safe = std::is_sorted(capsState_.begin(), capsState_.end())
-                && areXcenterSafe(xCentersState_)
-                && areTcenterSafe(tCentersState_);
+    bool safe = 0 == slotMismatches(capsState_.data(), kCapsBits)
+                && 0 == (orbitClassMismatches(xCentersState_.data(), kXcenterSides.data())
+                         & kStickersBits)
+                && 0 == (orbitClassMismatches(tCentersState_.data(), kTcenterSides.data())
+                         & kStickersBits);
     centersAreSafe_ = safe ? Yes : No;
 }
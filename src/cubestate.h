@@ -5,6 +5,7 @@
 #include <vector>
 #include <array>
 #include "cube_moves.h"
+#include "orbitkernels.h"
 #include "searchcriteria.h"
 
 /// @class CubeState describes state of 5x5 cube: corners, edges, x-centers, t-centers, wings, caps
@@ -50,6 +51,19 @@ public:
     CubeState& applyScramble(const MovesArray& moves);
     void applyScrambleMove(uint8_t move);
 
+    // applies move by walking scramblePermutations cycles. Slow; used to generate move tables
+    void applyScrambleMoveByCycles(uint8_t move);
+
+    // expanded destination maps of @param move for all orbits, see MovePermutation
+    static const MovePermutation& movePermutation(uint8_t move);
+
+    // solved cube with a single @param move applied, cached
+    static const CubeState& moveState(uint8_t move);
+
+    /* permutation algebra. States compose like the move sequences that produce them */
+    friend CubeState compose(const CubeState& x, const CubeState& y);
+    friend CubeState inverse(const CubeState& x);
+
     // user-friendlyness
     CubeState& applyStringScramble(std::string scramble);
 
@@ -83,18 +97,36 @@ public:
     // returns number of mismatches across all elements
     uint16_t totalNumMismatches() const;
 
-private:
-    StickersArray cornersState_ = cornersStateInitial;
-    StickersArray edgesState_ = edgesStateInitial;
-    StickersArray xCentersState_ = xCentersStateInitial;
-    StickersArray tCentersState_ = tCentersStateInitial;
-    StickersArray wingsState_ = wingsStateInitial;
-    CapsArray capsState_ = capsStateInitial;
+    // sticker at @param position of @param orbit (corners, edges, x, t, wings, caps)
+    uint8_t stickerAt(uint8_t orbit, uint8_t position) const {
+        return orbitSlots()[orbit * kOrbitSlotSize + position];
+    }
 
+    // 64-bit hash of all stickers, computed from the orbit slots on each call (a few ns),
+    // so moves don't pay for it and states can be shared between threads
+    uint64_t hash() const;
+
+    // true if all stickers are on the same positions
+    bool operator==(const CubeState& other) const;
+    bool operator!=(const CubeState& other) const;
+
+private:
     // cached result
     mutable CenterSafeInfo centersAreSafe_ = Yes;
     void reCalculateIfCentersAreSafe() const;
 
+    // each orbit occupies its own kOrbitSlotSize-aligned slot (see orbitkernels.h),
+    // so that a move is one byte shuffle per orbit. Keep them last and in this order
+    alignas(kOrbitSlotSize) StickersArray cornersState_ = cornersStateInitial;
+    alignas(kOrbitSlotSize) StickersArray edgesState_ = edgesStateInitial;
+    alignas(kOrbitSlotSize) StickersArray xCentersState_ = xCentersStateInitial;
+    alignas(kOrbitSlotSize) StickersArray tCentersState_ = tCentersStateInitial;
+    alignas(kOrbitSlotSize) StickersArray wingsState_ = wingsStateInitial;
+    alignas(kOrbitSlotSize) CapsArray capsState_ = capsStateInitial;
+
+    uint8_t* orbitSlots();
+    const uint8_t* orbitSlots() const;
+
     static StickersArray cornersStateInitial;
     static StickersArray edgesStateInitial;
     static StickersArray xCentersStateInitial;
@@ -102,6 +134,18 @@ private:
     static StickersArray wingsStateInitial;
     static CapsArray capsStateInitial;
 
+    // movePermutations_[m] is the expanded scramblePermutations entry for move m,
+    // moveShuffles_[m] is the same map in orbit slot layout (shuffle masks),
+    // movedStickers_[m] is the same map with non-moving stickers dropped (scalar fallback)
+    static const std::array<MovePermutation, kNumAllQtmMoves> movePermutations_;
+    alignas(kOrbitSlotSize) static const std::array<OrbitSlots, kNumAllQtmMoves> moveShuffles_;
+    static const std::array<MovedStickers, kNumAllQtmMoves> movedStickers_;
+    static const std::array<CubeState, kNumAllQtmMoves> moveStates_;
+    static std::array<MovePermutation, kNumAllQtmMoves> generateMovePermutations();
+    static std::array<OrbitSlots, kNumAllQtmMoves> generateMoveShuffles();
+    static std::array<MovedStickers, kNumAllQtmMoves> generateMovedStickers();
+    static std::array<CubeState, kNumAllQtmMoves> generateMoveStates();
+
     /// @param corner - if true, do this for corners, else do for edges
     std::string solveAndGetMultistickerCycles(std::array<uint8_t, kNumElemStickers>& state
                                       , const StringVec& config, bool corner);
@@ -109,4 +153,28 @@ private:
 
 std::ostream& operator<<(std::ostream& oss, const CubeState& cube);
 
+/// @returns x followed by y: state after applying y's moves to a cube in state x
+CubeState compose(const CubeState& x, const CubeState& y);
+
+/// @returns state that undoes x, i.e. compose(x, inverse(x)) is solved
+CubeState inverse(const CubeState& x);
+
+/// @returns by x by'
+CubeState conjugate(const CubeState& x, const CubeState& by);
+
+/// @returns x y x' y'
+CubeState commutator(const CubeState& x, const CubeState& y);
+
+/// @returns names of all stickers of the corner or edge with sticker @param sticker, starting
+/// from it, e.g. UFR, RUF, FRU. Twisting every sticker of a cycle to the next name of its
+/// piece gives the same cycle of pieces. Other elements have one sticker: {@param sticker}.
+/// Empty for unknown names
+StringVec pieceStickers(std::string_view sticker);
+
+namespace std {
+template<> struct hash<CubeState> {
+    size_t operator()(const CubeState& cube) const { return cube.hash(); }
+};
+}
+
 #endif // CUBESTATE_H
@@ -0,0 +1,94 @@
+#include "cubesymmetry.h"
+#include <algorithm>
+
+// faces "LURDFB" as unit vectors: axis (x, y, z) and sign
+constexpr std::array<uint8_t, kNumSides> kFaceAxis = {0, 1, 0, 1, 2, 2};
+constexpr std::array<int8_t, kNumSides> kFaceSign = {-1, 1, 1, -1, 1, -1};
+
+// slices M, E, S turn the way their reference faces L, D, F do
+constexpr uint8_t kNumOuterFaces = 6;
+constexpr std::array<uint8_t, 3> kSliceRefFace = {0, 3, 4}; // by axis
+constexpr uint8_t kFirstSlice = 2 * kNumOuterFaces;
+
+static uint8_t faceOf(uint8_t axis, int8_t sign) {
+    for (uint8_t f = 0; f < kNumSides; ++f)
+        if (kFaceAxis[f] == axis && kFaceSign[f] == sign)
+            return f;
+    return kNoMove;
+}
+
+// symmetry as a signed permutation of axes: axis a goes to axes[a] with sign signs[a]
+static MoveMap toMoveMap(const std::array<uint8_t, 3>& axes, const std::array<int8_t, 3>& signs
+                         , bool reflection) {
+    auto mapFace = [&](uint8_t f) {
+        return faceOf(axes[kFaceAxis[f]], int8_t(kFaceSign[f] * signs[kFaceAxis[f]]));
+    };
+    MoveMap map;
+    for (uint8_t move = 0; move < kNumAllQtmMoves; ++move) {
+        const uint8_t base = baseMove(move);
+        uint8_t prime = move / kNumQtmClockwiseMoves; // 0: qtm; 1: double; 2: prime
+        bool flip = reflection;
+        uint8_t mappedBase;
+        if (base < kFirstSlice) {
+            // outer face or the inner layer next to it
+            mappedBase = mapFace(base % kNumOuterFaces) + (base / kNumOuterFaces) * kNumOuterFaces;
+        } else {
+            const uint8_t face = mapFace(kSliceRefFace[base - kFirstSlice]);
+            mappedBase = kFirstSlice + kFaceAxis[face];
+            flip ^= (face != kSliceRefFace[kFaceAxis[face]]);
+        }
+        if (flip && 1 != prime)
+            prime = 2 - prime;
+        map[move] = mappedBase + prime * kNumQtmClockwiseMoves;
+    }
+    return map;
+}
+
+static std::array<MoveMap, kNumSymmetries> generateSymmetryMoveMaps() {
+    std::array<MoveMap, kNumSymmetries> maps;
+    uint8_t n = 0;
+    std::array<uint8_t, 3> axes = {0, 1, 2};
+    do {
+        // permutation parity: number of inversions
+        const bool oddPermutation = ((axes[0] > axes[1]) + (axes[0] > axes[2])
+                                     + (axes[1] > axes[2])) % 2;
+        for (uint8_t s = 0; s < 8; ++s) {
+            const std::array<int8_t, 3> signs = {int8_t(s & 1 ? -1 : 1), int8_t(s & 2 ? -1 : 1),
+                                                 int8_t(s & 4 ? -1 : 1)};
+            const bool reflection = oddPermutation ^ (signs[0] * signs[1] * signs[2] < 0);
+            maps[n++] = toMoveMap(axes, signs, reflection);
+        }
+    } while (std::next_permutation(axes.begin(), axes.end()));
+    return maps;
+}
+
+const std::array<MoveMap, kNumSymmetries>& symmetryMoveMaps() {
+    static const std::array<MoveMap, kNumSymmetries> maps = generateSymmetryMoveMaps();
+    return maps;
+}
+
+MovesArray applyMoveMap(const MoveMap& map, const MovesArray& moves) {
+    MovesArray result = emptyMovesArray();
+    for (uint8_t i = 0; i < moves.size() && kNoMove != moves[i]; ++i)
+        result[i] = map[moves[i]];
+    // bubble parallel moves into ascending order; moves of different axes never swap
+    const uint8_t size = numMoves(result);
+    for (bool swapped = true; swapped;) {
+        swapped = false;
+        for (uint8_t i = 0; i + 1 < size; ++i) {
+            if (areParallelLayersMoves(result[i], result[i+1])
+                    && baseMove(result[i]) > baseMove(result[i+1])) {
+                std::swap(result[i], result[i+1]);
+                swapped = true;
+            }
+        }
+    }
+    return result;
+}
+
+uint8_t symmetryRepresentative(uint8_t move) {
+    uint8_t representative = move;
+    for (const MoveMap& map: symmetryMoveMaps())
+        representative = std::min(representative, map[move]);
+    return representative;
+}
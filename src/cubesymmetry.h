@@ -0,0 +1,26 @@
+#ifndef CUBESYMMETRY_H
+#define CUBESYMMETRY_H
+#include <array>
+#include "cube_moves.h"
+
+// Symmetries of the cube: 24 rotations, each with and without reflection.
+// A symmetry maps every move to a move, e.g. rotation y maps R to F and reflection L<->R maps
+// R to L'. Conjugating a cube state by a symmetry relabels its pieces, so [A, B] and its image
+// have the same CaseType
+
+constexpr uint8_t kNumSymmetries = 48;
+
+// moveMap[m] is the image of move m
+using MoveMap = std::array<uint8_t, kNumAllQtmMoves>;
+
+/// @returns move maps of all symmetries, identity first
+const std::array<MoveMap, kNumSymmetries>& symmetryMoveMaps();
+
+/// @returns @param moves mapped by @param map. Runs of parallel moves are reordered back
+/// to ascending order, as IncrementalScramble generates them ("R L" -> "L R")
+MovesArray applyMoveMap(const MoveMap& map, const MovesArray& moves);
+
+/// @returns the smallest move some symmetry maps @param move to
+uint8_t symmetryRepresentative(uint8_t move);
+
+#endif // CUBESYMMETRY_H
@@ -0,0 +1,44 @@
+#include <easylogging++.h>
+#include <iostream>
+#include <fstream>
+
+#include "resultformat.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+static int showUsage(char* name) {
+    std::cerr << "Usage: " << name << " results.bin [results.txt]\n"
+        << "\tconverts binary results of commfinder --binary to the text format,"
+        << " exactly as commfinder writes it without --binary\n"
+        << "\tresults.txt: output file, standard output if omitted"
+        << std::endl;
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Format, "%datetime %level %msg");
+
+    if (argc < 2 || argc > 3 || std::string(argv[1]) == "-h")
+        return showUsage(argv[0]);
+    std::ofstream file;
+    if (3 == argc) {
+        file.open(argv[2], std::ios::binary | std::ios::trunc);
+        LOG_IF(!file, FATAL) << "can't open file " << argv[2] << " for writing";
+    }
+    std::ostream& out = (3 == argc) ? file : std::cout;
+
+    // records are converted one block at a time, so files of any size are streamed
+    ResultReader reader(argv[1]);
+    uint64_t numResults = 0;
+    for (ResultRecord record; reader.next(record); ++numResults)
+        out << resultToText(record);
+    out.flush();
+    if (!reader.error().empty()) {
+        LOG(ERROR) << reader.error() << ". Exported " << numResults << " results before it";
+        return -1;
+    }
+    LOG_IF(!out, FATAL) << "failed to write results";
+    if (3 == argc)
+        LOG(INFO) << "Exported " << numResults << " results to " << argv[2];
+    return 0;
+}
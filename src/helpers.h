@@ -110,4 +110,17 @@ bool hasGroupedByButNotSorted(uint8_t groupSize, const std::array<uint8_t, SIZE>
     return has;
 }
 
+/// @returns true if @param bits has all bits of at least one group set, where groups are
+/// [0,groupSize), [groupSize,2*groupSize)... within first @param size bits.
+/// Bitmask counterpart of hasGroupedByButNotSorted
+inline bool hasFullBitGroup(uint32_t bits, uint8_t groupSize, uint8_t size) {
+    uint32_t full = bits;
+    for (uint8_t k = 1; k < groupSize; ++k)
+        full &= bits >> k;
+    uint32_t groupStarts = 0;
+    for (uint8_t i = 0; i + groupSize <= size; i += groupSize)
+        groupStarts |= uint32_t(1) << i;
+    return 0 != (full & groupStarts);
+}
+
 #endif // SMC_HELPERS_H
@@ -11,40 +11,53 @@ void IncrementalScramble::reset() {
     size_ = 1;
 }
 
-IncrementalScramble& IncrementalScramble::operator++() {
-    static bool hasRedundancy;
+// kFirstAllowedMove[next][from] is the smallest move >= from that may precede move next
+// (see canFollow) or kNoMove if there is none. Row kNumAllQtmMoves is for the last move of
+// a scramble, which is not followed by anything
+using AllowedMovesTable = std::array<std::array<uint8_t, kNumAllQtmMoves + 1>
+                                     , kNumAllQtmMoves + 1>;
 
-    do {
-        hasRedundancy = false;
-        ++moves_[0];
-        for (uint8_t i = 0; i < size_ && moves_[i] >= kNumAllQtmMoves;) {
-            moves_[i] = 0;
-            if (i == size_ - 1) {
-                moves_[i] = 0;
-                moves_[size_++] = 0;
-            } else {
-                ++moves_[++i];
-            }
+static AllowedMovesTable generateFirstAllowedMoves() {
+    AllowedMovesTable table;
+    for (uint8_t next = 0; next <= kNumAllQtmMoves; ++next) {
+        uint8_t allowed = kNoMove;
+        for (int from = kNumAllQtmMoves; from >= 0; --from) {
+            if (from < kNumAllQtmMoves && (kNumAllQtmMoves == next || canFollow(from, next)))
+                allowed = from;
+            table[next][from] = allowed;
         }
+    }
+    return table;
+}
 
-        // L U U' F -> increment U, reset everything to the left, decrement
-        for (uint8_t j = 0; j < size_-1; ++j) {
-            if (areMovesOfSameFace(moves_[j], moves_[j+1])) {
-                hasRedundancy = true;
-                break;
-            }
-        }
+static const AllowedMovesTable kFirstAllowedMove = generateFirstAllowedMoves();
 
-        // Remove "URL"="ULR" redundancy by placing parallel moves in ascending order
-        if (!hasRedundancy) {
-            for (uint8_t j = 0; j < size_-1; ++j) {
-                if (areParallelLayersMoves(moves_[j], moves_[j+1])) {
-                    hasRedundancy |= (baseMove(moves_[j]) >= baseMove(moves_[j+1]));
-                    if (hasRedundancy) {
-                        break;
-                    }
-        }   }   }
-    } while (hasRedundancy);
+void IncrementalScramble::set(const MovesArray& moves) {
+    moves_ = moves;
+    size_ = numMoves(moves_);
+    LOG_IF(0 == size_, FATAL) << "empty scramble";
+}
+
+IncrementalScramble& IncrementalScramble::operator++() {
+    // moves_[i] precedes moves_[i+1], moves_[0] increments fastest. Increment the lowest move
+    // that has a greater allowed value and reset all moves below it to their smallest allowed
+    // values, so no redundant scramble is ever generated: "L U U' F", "U R L" are never visited
+    uint8_t i = 0;
+    for (; i < size_; ++i) {
+        const uint8_t next = (i + 1 < size_) ? moves_[i+1] : kNumAllQtmMoves;
+        const uint8_t move = kFirstAllowedMove[next][moves_[i] + 1];
+        if (kNoMove != move) {
+            moves_[i] = move;
+            break;
+        }
+    }
+    if (i == size_) {
+        // all moves have their greatest allowed values: next size begins with L
+        moves_[size_++] = 0;
+        i = size_ - 1;
+    }
+    while (i-- > 0)
+        moves_[i] = kFirstAllowedMove[moves_[i+1]][0];
 
     return *this;
 }
@@ -69,20 +82,19 @@ IncrementalScramble &IncrementalScramble::incAndSkipParallelBeginEnd(uint8_t mov
     return *this;
 }
 
+IncrementalScramble& IncrementalScramble::skipSubtree(uint8_t i, uint8_t parallelTo) {
+    // moves below i at their greatest values: the next increment carries over to move #i
+    for (uint8_t j = 0; j < i && j < size_; ++j)
+        moves_[j] = kNumAllQtmMoves - 1;
+    return kNoMove == parallelTo ? operator++() : incAndSkipParallelBeginEnd(parallelTo);
+}
+
 std::string IncrementalScramble::toString() const {
     return ::toString(moves_);
 }
 
 std::string IncrementalScramble::progress() const {
-    if (size_ < 3)
-        return "instant";
-    constexpr double k1 = kNumAllQtmMoves, k2 = k1*k1, k3 = k1*k1*k1;
-    constexpr double maxProgress = k3 + k2 + k1;
-    double it = moves_[size_-1] * k2
-              + moves_[size_-2] * k1
-              + moves_[size_-3];
-    std::string result = std::to_string(it/maxProgress*100.) + "%";
-    return result;
+    return std::to_string(100. * rank(moves_) / count(size_)) + "%";
 }
 
 const MovesArray &IncrementalScramble::get() const {
@@ -92,3 +104,91 @@ const MovesArray &IncrementalScramble::get() const {
 std::size_t IncrementalScramble::size() const {
     return size_;
 }
+
+constexpr uint8_t kNumExclusions = ScrambleCounter::kNumExclusions;
+constexpr std::array<uint8_t, kNumExclusions> kExcludedParallelTo = {kNoMove, 0, 1, 4};
+
+static uint8_t exclusionOf(uint8_t parallelTo) {
+    for (uint8_t e = 1; e < kNumExclusions; ++e)
+        if (kNoMove != parallelTo && areParallelLayersMoves(parallelTo, kExcludedParallelTo[e]))
+            return e;
+    return 0;
+}
+
+static bool isExcluded(uint8_t move, uint8_t exclusion) {
+    return 0 != exclusion && areParallelLayersMoves(move, kExcludedParallelTo[exclusion]);
+}
+
+ScrambleCounter::ScrambleCounter(const MoveSet& moves): moves_(moves), counts_{} {
+    // counts_[exclusion][size][m] is number of scrambles of size moves from moves_ that end
+    // with m and whose first move isn't excluded
+    for (uint8_t e = 0; e < kNumExclusions; ++e) {
+        for (uint8_t m = 0; m < kNumAllQtmMoves; ++m)
+            counts_[e][1][m] = moves_[m] && !isExcluded(m, e);
+        for (uint8_t size = 2; size <= kMaxScrambleLength; ++size)
+            for (uint8_t m = 0; m < kNumAllQtmMoves; ++m)
+                for (uint8_t prev = 0; prev < kNumAllQtmMoves && moves_[m]; ++prev)
+                    if (canFollow(prev, m))
+                        counts_[e][size][m] += counts_[e][size-1][prev];
+    }
+}
+
+uint64_t ScrambleCounter::count(uint8_t size, uint8_t parallelTo, uint8_t lastMoveBelow) const {
+    LOG_IF(size > kMaxScrambleLength, FATAL) << "scramble size " << int(size) << " is too big";
+    const uint8_t e = exclusionOf(parallelTo);
+    uint64_t result = 0;
+    for (uint8_t m = 0; m < lastMoveBelow && m < kNumAllQtmMoves; ++m)
+        if (!isExcluded(m, e))
+            result += counts_[e][size][m];
+    return result;
+}
+
+uint64_t ScrambleCounter::rank(const MovesArray& moves, uint8_t parallelTo) const {
+    // last move is the most significant one: count scrambles with a smaller move there and
+    // any allowed moves before it, then the same for every move below
+    const uint8_t e = exclusionOf(parallelTo);
+    const uint8_t size = numMoves(moves);
+    uint64_t result = 0;
+    for (int i = size - 1; i >= 0; --i) {
+        for (uint8_t m = 0; m < moves[i]; ++m)
+            if (i == size - 1 ? !isExcluded(m, e) : canFollow(m, moves[i+1]))
+                result += counts_[e][i+1][m];
+        // not visited itself: nothing with this last move is
+        if ((i == size - 1 && isExcluded(moves[i], e)) || !moves_[moves[i]])
+            break;
+    }
+    return result;
+}
+
+MovesArray ScrambleCounter::unrank(uint8_t size, uint64_t index, uint8_t parallelTo) const {
+    LOG_IF(index >= count(size, parallelTo), FATAL) << "scramble #" << index << " of "
+            << int(size) << " moves doesn't exist";
+    const uint8_t e = exclusionOf(parallelTo);
+    MovesArray moves = emptyMovesArray();
+    for (int i = size - 1; i >= 0; --i) {
+        for (uint8_t m = 0; m < kNumAllQtmMoves; ++m) {
+            if (i == size - 1 ? isExcluded(m, e) : !canFollow(m, moves[i+1]))
+                continue;
+            if (index < counts_[e][i+1][m]) {
+                moves[i] = m;
+                break;
+            }
+            index -= counts_[e][i+1][m];
+        }
+    }
+    return moves;
+}
+
+static const ScrambleCounter kAllScrambles(allMoves());
+
+uint64_t IncrementalScramble::count(uint8_t size, uint8_t parallelTo, uint8_t lastMoveBelow) {
+    return kAllScrambles.count(size, parallelTo, lastMoveBelow);
+}
+
+uint64_t IncrementalScramble::rank(const MovesArray& moves, uint8_t parallelTo) {
+    return kAllScrambles.rank(moves, parallelTo);
+}
+
+MovesArray IncrementalScramble::unrank(uint8_t size, uint64_t index, uint8_t parallelTo) {
+    return kAllScrambles.unrank(size, index, parallelTo);
+}
@@ -18,10 +18,15 @@ public:
     /// increments and skips cases when first or last move is parallel to @param move
     IncrementalScramble& incAndSkipParallelBeginEnd(uint8_t move);
 
+    /// skips all scrambles that end with the current moves #@param i and later, i.e. the whole
+    /// subtree of moves #0..i-1. With @param parallelTo other than kNoMove, skips like
+    /// incAndSkipParallelBeginEnd(parallelTo)
+    IncrementalScramble& skipSubtree(uint8_t i, uint8_t parallelTo = kNoMove);
+
     /// \returns current alg as a sequence of moves
     std::string toString() const;
 
-    /// \returns progress for current size_ - report string in percent
+    /// \returns progress within current size_ - report string in percent
     std::string progress() const;
 
     /// \returns current scramble
@@ -30,11 +35,50 @@ public:
     /// resets the scramble
     void reset();
 
+    /// continue from @param moves, e.g. unrank() result
+    void set(const MovesArray& moves);
+
     /// \returns current alg size
     std::size_t size() const;
+
+    // Counting and random access. With @param parallelTo other than kNoMove, only scrambles
+    // that incAndSkipParallelBeginEnd(parallelTo) visits are considered: first and last moves
+    // aren't parallel to it (initial "L" is not counted either)
+
+    /// \returns number of scrambles of @param size moves whose last move is less than
+    /// @param lastMoveBelow
+    static uint64_t count(uint8_t size, uint8_t parallelTo = kNoMove
+                          , uint8_t lastMoveBelow = kNumAllQtmMoves);
+
+    /// \returns number of scrambles of the same size generated before @param moves.
+    /// Works for scrambles that are not visited themselves too
+    static uint64_t rank(const MovesArray& moves, uint8_t parallelTo = kNoMove);
+
+    /// \returns scramble of @param size moves with rank @param index
+    static MovesArray unrank(uint8_t size, uint64_t index, uint8_t parallelTo = kNoMove);
 private:
     uint8_t size_;
     MovesArray moves_;
 };
 
+// count, rank and unrank of IncrementalScramble for scrambles of moves from a given set only,
+// e.g. partB candidates of CommutatorFinder::setAllowedMoves. Scrambles with other moves are
+// skipped as if they didn't exist
+class ScrambleCounter {
+public:
+    explicit ScrambleCounter(const MoveSet& moves);
+
+    uint64_t count(uint8_t size, uint8_t parallelTo = kNoMove
+                   , uint8_t lastMoveBelow = kNumAllQtmMoves) const;
+    uint64_t rank(const MovesArray& moves, uint8_t parallelTo = kNoMove) const;
+    MovesArray unrank(uint8_t size, uint64_t index, uint8_t parallelTo = kNoMove) const;
+
+    // scrambles are counted separately for each excluded layer: none, parallel to L, U and F
+    static constexpr uint8_t kNumExclusions = 4;
+private:
+    MoveSet moves_;
+    std::array<std::array<std::array<uint64_t, kNumAllQtmMoves>, kMaxScrambleLength + 1>
+               , kNumExclusions> counts_;
+};
+
 #endif // INCREMENTALSCRAMBLE_H
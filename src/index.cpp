@@ -0,0 +1,30 @@
+#include <easylogging++.h>
+#include <iostream>
+
+#include "resultindex.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+static int showUsage(char* name) {
+    std::cerr << "Usage: " << name << " index_path results_file...\n"
+        << "\tindexes results of commfinder (text or --binary files) for commfinder-query\n"
+        << "\tresults_file: e.g. /path/to/all_results.txt or /path/to/dir/*moves.txt"
+        << std::endl;
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Format, "%datetime %level %msg");
+
+    if (argc < 3 || std::string(argv[1]) == "-h")
+        return showUsage(argv[0]);
+    const std::vector<std::string> inputPaths(argv + 2, argv + argc);
+    std::string error;
+    const int64_t numResults = buildResultIndex(inputPaths, argv[1], error);
+    if (numResults < 0) {
+        LOG(ERROR) << error;
+        return -1;
+    }
+    LOG(INFO) << "Indexed " << numResults << " results to " << argv[1];
+    return 0;
+}
@@ -1,21 +1,47 @@
 #include <easylogging++.h>
 #include <iostream>
+#include <cstdio>
+#include <csignal>
 
 #include "incrementalscramble.h"
 #include "cubestate.h"
 #include "cube_moves.h"
 #include "commutatorfinder.h"
+#include "helpers.h"
 
 INITIALIZE_EASYLOGGINGPP
 
 static int showUsage(char* name) {
-    std::cerr << "Usage: " << name << " output_path max_moves\n"
+    std::cerr << "Usage: " << name
+        << " output_path max_moves [--mode incremental|dfs|partb-first] [--symmetry]"
+        << " [--threads N] [--shard i/N] [--resume] [--binary] [--cases c3cycles,...]"
+        << " [--relevant-layers] [--inert tag|drop] [--moves R,U,r,u,M]\n"
         << "\toutput_path: either /path/to/all_results.txt or /path/to/dir/\n"
-        << "\tmax_moves: maximum number of partB moves in [A, B] commutators"
+        << "\tmax_moves: maximum number of partB moves in [A, B] commutators\n"
+        << "\t--mode: order of search. dfs and partb-first find the same results faster, "
+        << "but they are not sorted by partA and partB length\n"
+        << "\t--symmetry: search one partA per cube symmetry class, derive the rest\n"
+        << "\t--threads: number of search threads, each takes depth-first subtrees\n"
+        << "\t--shard: search only shard i (1..N) of N; merge results with commfinder-merge\n"
+        << "\t--resume: continue the search from the checkpoint left by SIGINT, SIGTERM or a crash\n"
+        << "\t--binary: save compact binary records; convert them to text with commfinder-export\n"
+        << "\t--cases: comma-separated case types to search, e.g. c3cycles,corner2Twists. All "
+        << "by default\n"
+        << "\t--relevant-layers: discard algs with moves that don't touch elements of their case,"
+        << " e.g. M in corner algs. Narrow --cases then search much faster\n"
+        << "\t--inert: tag or drop algs with a partB move that can be deleted without changing"
+        << " the result, e.g. M in [L, U2 M U R U]\n"
+        << "\t--moves: generators of partA and partB; a layer stands for all its moves,"
+        << " U2 or U' for just that move. No wide moves (Rw). All moves by default"
         << std::endl;
     return -1;
 }
 
+// finish the current work, save a checkpoint and exit
+static void onStopSignal(int) {
+    CommutatorFinder::requestStop();
+}
+
 int main(int argc, char** argv) {
     el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Format, "%datetime %level %msg");
     el::Loggers::addFlag(el::LoggingFlag::ColoredTerminalOutput);
@@ -25,11 +51,79 @@ int main(int argc, char** argv) {
 
     std::string outputPath(argv[1]);
     unsigned int maxMovesPartB = std::stoi(argv[2]);
+    SearchMode mode = SearchMode::Incremental;
+    bool useSymmetry = false;
+    unsigned numThreads = 1;
+    unsigned shardIndex = 1, numShards = 1;
+    bool resume = false;
+    bool binaryOutput = false;
+    bool relevantLayersOnly = false;
+    InertMoves inertMoves = InertMoves::Keep;
+    MoveSet allowedMoves = allMoves();
+    std::vector<CaseType> cases;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--mode" && i + 1 < argc) {
+            std::string value(argv[++i]);
+            if (value == "dfs")
+                mode = SearchMode::DepthFirst;
+            else if (value == "partb-first")
+                mode = SearchMode::PartBFirst;
+            else if (value != "incremental")
+                return showUsage(argv[0]);
+        } else if (arg == "--symmetry") {
+            useSymmetry = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            numThreads = std::stoi(argv[++i]);
+        } else if (arg == "--shard" && i + 1 < argc) {
+            if (2 != std::sscanf(argv[++i], "%u/%u", &shardIndex, &numShards)
+                    || 0 == shardIndex || shardIndex > numShards)
+                return showUsage(argv[0]);
+        } else if (arg == "--resume") {
+            resume = true;
+        } else if (arg == "--binary") {
+            binaryOutput = true;
+        } else if (arg == "--cases" && i + 1 < argc) {
+            for (const auto& name: splitString(argv[++i], ',')) {
+                cases.push_back(caseTypeFromString(name));
+                if (CaseType::caseTypeEnd == cases.back())
+                    return showUsage(argv[0]);
+            }
+        } else if (arg == "--relevant-layers") {
+            relevantLayersOnly = true;
+        } else if (arg == "--inert" && i + 1 < argc) {
+            std::string value(argv[++i]);
+            if (value == "tag")
+                inertMoves = InertMoves::Tag;
+            else if (value == "drop")
+                inertMoves = InertMoves::Drop;
+            else
+                return showUsage(argv[0]);
+        } else if (arg == "--moves" && i + 1 < argc) {
+            if (!stringToMoveSet(argv[++i], allowedMoves))
+                return showUsage(argv[0]);
+        } else {
+            return showUsage(argv[0]);
+        }
+    }
 
-    SearchCriteria criteriaAll(true, CenterSafety::SolvedCenterSafe);
+    SearchCriteria criteriaAll(cases.empty(), CenterSafety::SolvedCenterSafe);
     // we don't look for algs that solve a solved cube
     criteriaAll.set(CaseType::allSolved, false);
+    for (CaseType ct: cases)
+        criteriaAll.set(ct, true);
     CommutatorFinder cf(maxMovesPartB, criteriaAll, outputPath);
+    cf.setSearchMode(mode);
+    cf.setUseSymmetry(useSymmetry);
+    cf.setNumThreads(numThreads);
+    cf.setShard(shardIndex - 1, numShards);
+    cf.setResume(resume);
+    cf.setBinaryOutput(binaryOutput);
+    cf.setRelevantLayersOnly(relevantLayersOnly);
+    cf.setInertMoves(inertMoves);
+    cf.setAllowedMoves(allowedMoves);
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
     cf.find();
 
     return 0;
@@ -0,0 +1,50 @@
+#include <easylogging++.h>
+#include <iostream>
+
+#include "commutatorfinder.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+static int showUsage(char* name) {
+    std::cerr << "Usage: " << name << " output_path max_moves num_shards [--binary]"
+        << " [--delete-inputs]\n"
+        << "\tmerges results of commfinder output_path max_moves --shard i/num_shards"
+        << " for all i into output_path. Every shard should be finished\n"
+        << "\toutput_path: either /path/to/all_results.txt or /path/to/dir/\n"
+        << "\t--binary: shards were searched with --binary\n"
+        << "\t--delete-inputs: remove shard files and their checkpoints after merging"
+        << std::endl;
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Format, "%datetime %level %msg");
+
+    if (argc < 4)
+        return showUsage(argv[0]);
+    bool binary = false, deleteInputs = false;
+    for (int i = 4; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        if (arg == "--binary")
+            binary = true;
+        else if (arg == "--delete-inputs")
+            deleteInputs = true;
+        else
+            return showUsage(argv[0]);
+    }
+    const std::string outputPath(argv[1]);
+    const int maxMovesPartB = std::stoi(argv[2]);
+    const int numShards = std::stoi(argv[3]);
+    if (outputPath.empty() || maxMovesPartB < 1 || maxMovesPartB > kMaxScrambleLength
+        || numShards < 1)
+        return showUsage(argv[0]);
+
+    const int64_t total = mergeShards(outputPath, maxMovesPartB, numShards, binary, deleteInputs);
+    if (total < 0) {
+        LOG(ERROR) << "Nothing merged, shards are kept";
+        return -1;
+    }
+    LOG(INFO) << "Merged " << numShards << " shards: " << total << " commutators in "
+              << outputPath;
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include "orbitkernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ORBITKERNELS_X86
+#endif
+
+static void gatherOrbitsScalar(uint8_t* slots, const uint8_t* map) {
+    for (uint8_t o = 0; o < kNumOrbits; ++o) {
+        uint8_t* slot = slots + o * kOrbitSlotSize;
+        const uint8_t* mask = map + o * kOrbitSlotSize;
+        std::array<uint8_t, kOrbitSlotSize> before;
+        std::copy(slot, slot + kOrbitSlotSize, before.begin());
+        for (uint8_t i = 0; i < kOrbitSlotSize; ++i)
+            slot[i] = before[mask[i] % kOrbitSlotSize];
+    }
+}
+
+static uint32_t mismatchesScalar(const uint8_t* slot) {
+    uint32_t bits = 0;
+    for (uint8_t i = 0; i < kOrbitSlotSize; ++i)
+        bits |= uint32_t(slot[i] != i) << i;
+    return bits;
+}
+
+static uint32_t classMismatchesScalar(const uint8_t* slot, const uint8_t* table) {
+    uint32_t bits = 0;
+    for (uint8_t i = 0; i < kOrbitSlotSize; ++i)
+        bits |= uint32_t(table[slot[i] % kOrbitSlotSize] != table[i]) << i;
+    return bits;
+}
+
+#ifdef ORBITKERNELS_X86
+// two 16-byte halves; pshufb zeroes bytes whose mask has the high bit set,
+// so each output half is (lo shuffled by indices < 16) | (hi shuffled by indices >= 16)
+__attribute__((target("ssse3")))
+static void gatherOrbitsSsse3(uint8_t* slots, const uint8_t* map) {
+    const __m128i kIndexBits = _mm_set1_epi8(kOrbitSlotSize - 1);
+    const __m128i kHalf = _mm_set1_epi8(15);
+    const __m128i kOnes = _mm_set1_epi8(-1);
+    for (uint8_t o = 0; o < kNumOrbits; ++o) {
+        __m128i* slot = reinterpret_cast<__m128i*>(slots + o * kOrbitSlotSize);
+        const __m128i* mask = reinterpret_cast<const __m128i*>(map + o * kOrbitSlotSize);
+        const __m128i lo = _mm_loadu_si128(slot);
+        const __m128i hi = _mm_loadu_si128(slot + 1);
+        __m128i result[2];
+        for (uint8_t h = 0; h < 2; ++h) {
+            const __m128i idx = _mm_and_si128(_mm_loadu_si128(mask + h), kIndexBits);
+            const __m128i fromHi = _mm_cmpgt_epi8(idx, kHalf);
+            const __m128i fromLo = _mm_xor_si128(fromHi, kOnes);
+            result[h] = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_or_si128(idx, fromHi)),
+                                     _mm_shuffle_epi8(hi, _mm_or_si128(idx, fromLo)));
+        }
+        _mm_storeu_si128(slot, result[0]);
+        _mm_storeu_si128(slot + 1, result[1]);
+    }
+}
+
+__attribute__((target("ssse3")))
+static uint32_t mismatchesSsse3(const uint8_t* slot) {
+    const __m128i kIdentityLo = _mm_setr_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+    const __m128i kIdentityHi = _mm_add_epi8(kIdentityLo, _mm_set1_epi8(16));
+    const __m128i* v = reinterpret_cast<const __m128i*>(slot);
+    const uint32_t matchLo = uint16_t(_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_loadu_si128(v), kIdentityLo)));
+    const uint32_t matchHi = uint16_t(_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_loadu_si128(v + 1), kIdentityHi)));
+    return ~(matchLo | matchHi << 16);
+}
+
+// table lookup is the same two-half shuffle as in gatherOrbitsSsse3
+__attribute__((target("ssse3")))
+static uint32_t classMismatchesSsse3(const uint8_t* slot, const uint8_t* table) {
+    const __m128i kIndexBits = _mm_set1_epi8(kOrbitSlotSize - 1);
+    const __m128i kHalf = _mm_set1_epi8(15);
+    const __m128i kOnes = _mm_set1_epi8(-1);
+    const __m128i* v = reinterpret_cast<const __m128i*>(slot);
+    const __m128i t[2] = {_mm_loadu_si128(reinterpret_cast<const __m128i*>(table)),
+                          _mm_loadu_si128(reinterpret_cast<const __m128i*>(table) + 1)};
+    uint32_t match = 0;
+    for (uint8_t h = 0; h < 2; ++h) {
+        const __m128i idx = _mm_and_si128(_mm_loadu_si128(v + h), kIndexBits);
+        const __m128i fromHi = _mm_cmpgt_epi8(idx, kHalf);
+        const __m128i fromLo = _mm_xor_si128(fromHi, kOnes);
+        const __m128i classes = _mm_or_si128(_mm_shuffle_epi8(t[0], _mm_or_si128(idx, fromHi)),
+                                             _mm_shuffle_epi8(t[1], _mm_or_si128(idx, fromLo)));
+        match |= uint32_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(classes, t[h])))) << (16*h);
+    }
+    return ~match;
+}
+
+// vpshufb only shuffles within 128-bit lanes: shuffle both lane broadcasts and blend
+__attribute__((target("avx2")))
+static void gatherOrbitsAvx2(uint8_t* slots, const uint8_t* map) {
+    const __m256i kIndexBits = _mm256_set1_epi8(kOrbitSlotSize - 1);
+    const __m256i kHalf = _mm256_set1_epi8(15);
+    for (uint8_t o = 0; o < kNumOrbits; ++o) {
+        __m256i* slot = reinterpret_cast<__m256i*>(slots + o * kOrbitSlotSize);
+        const __m256i v = _mm256_loadu_si256(slot);
+        const __m256i idx = _mm256_and_si256(_mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(map + o * kOrbitSlotSize)), kIndexBits);
+        const __m256i lo = _mm256_permute2x128_si256(v, v, 0x00);
+        const __m256i hi = _mm256_permute2x128_si256(v, v, 0x11);
+        const __m256i fromHi = _mm256_cmpgt_epi8(idx, kHalf);
+        _mm256_storeu_si256(slot, _mm256_blendv_epi8(_mm256_shuffle_epi8(lo, idx),
+                                                     _mm256_shuffle_epi8(hi, idx), fromHi));
+    }
+}
+
+__attribute__((target("avx2")))
+static uint32_t mismatchesAvx2(const uint8_t* slot) {
+    const __m256i kIdentity = _mm256_setr_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,
+                                               16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31);
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slot));
+    return ~uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, kIdentity)));
+}
+
+__attribute__((target("avx2")))
+static uint32_t classMismatchesAvx2(const uint8_t* slot, const uint8_t* table) {
+    const __m256i kIndexBits = _mm256_set1_epi8(kOrbitSlotSize - 1);
+    const __m256i kHalf = _mm256_set1_epi8(15);
+    const __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(table));
+    const __m256i idx = _mm256_and_si256(_mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(slot)), kIndexBits);
+    const __m256i lo = _mm256_permute2x128_si256(t, t, 0x00);
+    const __m256i hi = _mm256_permute2x128_si256(t, t, 0x11);
+    const __m256i fromHi = _mm256_cmpgt_epi8(idx, kHalf);
+    const __m256i classes = _mm256_blendv_epi8(_mm256_shuffle_epi8(lo, idx),
+                                               _mm256_shuffle_epi8(hi, idx), fromHi);
+    return ~uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(classes, t)));
+}
+
+// vpermb permutes bytes across the whole register and ignores index bits above 5
+__attribute__((target("avx512vbmi,avx512vl")))
+static void gatherOrbitsVbmi(uint8_t* slots, const uint8_t* map) {
+    for (uint8_t o = 0; o < kNumOrbits; ++o) {
+        __m256i* slot = reinterpret_cast<__m256i*>(slots + o * kOrbitSlotSize);
+        const __m256i idx = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(map + o * kOrbitSlotSize));
+        const __m256i v = _mm256_loadu_si256(slot);
+        _mm256_storeu_si256(slot, _mm256_mask_permutexvar_epi8(v, __mmask32(-1), idx, v));
+    }
+}
+
+__attribute__((target("avx512vbmi,avx512vl")))
+static uint32_t classMismatchesVbmi(const uint8_t* slot, const uint8_t* table) {
+    const __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(table));
+    const __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slot));
+    const __m256i classes = _mm256_mask_permutexvar_epi8(t, __mmask32(-1), idx, t);
+    return ~uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(classes, t)));
+}
+#endif
+
+std::vector<OrbitKernel> supportedOrbitKernels() {
+    std::vector<OrbitKernel> kernels;
+#ifdef ORBITKERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("avx512vl"))
+        kernels.push_back({"avx512vbmi", gatherOrbitsVbmi, mismatchesAvx2, classMismatchesVbmi
+                           , true});
+    if (__builtin_cpu_supports("avx2"))
+        kernels.push_back({"avx2", gatherOrbitsAvx2, mismatchesAvx2, classMismatchesAvx2, true});
+    if (__builtin_cpu_supports("ssse3"))
+        kernels.push_back({"ssse3", gatherOrbitsSsse3, mismatchesSsse3, classMismatchesSsse3
+                           , true});
+#endif
+    kernels.push_back({"scalar", gatherOrbitsScalar, mismatchesScalar, classMismatchesScalar
+                       , false});
+    return kernels;
+}
+
+const OrbitKernel& bestOrbitKernel() {
+    static const OrbitKernel best = supportedOrbitKernels().front();
+    return best;
+}
+
+OrbitSlots toOrbitSlots(const MovePermutation& perm) {
+    OrbitSlots slots;
+    for (uint8_t o = 0; o < kNumOrbits; ++o) {
+        for (uint8_t i = 0; i < kOrbitSlotSize; ++i)
+            slots[o][i] = i;
+        std::copy(perm[o].begin(), perm[o].end(), slots[o].begin());
+    }
+    return slots;
+}
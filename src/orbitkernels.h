@@ -0,0 +1,45 @@
+#ifndef ORBITKERNELS_H
+#define ORBITKERNELS_H
+#include <string_view>
+#include <vector>
+#include <array>
+#include "cube_moves.h"
+
+// Byte-shuffle kernels over cube states stored as kNumOrbits slots of kOrbitSlotSize bytes.
+// Each orbit is padded to a full AVX2 register (or a pair of SSE registers), so applying
+// a permutation to an orbit is a single shuffle against a precomputed mask.
+
+constexpr uint8_t kOrbitSlotSize = 32;
+
+// one shuffle mask per orbit; bytes past the orbit size keep their position (identity)
+using OrbitSlots = std::array<std::array<uint8_t, kOrbitSlotSize>, kNumOrbits>;
+
+// in-place gather for all orbits: slots[o][i] = slots before the call[o][map[o][i] % 32]
+// both pointers should be kOrbitSlotSize-aligned
+using GatherOrbitsFn = void (*)(uint8_t* slots, const uint8_t* map);
+
+// comparisons of a single orbit slot, one bit per byte. Bits past the orbit size are garbage
+// bit i is set if slot[i] != i, i.e. sticker i is not on its place
+using OrbitMismatchesFn = uint32_t (*)(const uint8_t* slot);
+// bit i is set if table[slot[i] % 32] != table[i]: sticker i went to a different class
+// (piece, side etc.) than the one it belongs to. @param table is kOrbitSlotSize bytes
+using OrbitClassMismatchesFn = uint32_t (*)(const uint8_t* slot, const uint8_t* table);
+
+struct OrbitKernel {
+    std::string_view name;
+    GatherOrbitsFn gather;
+    OrbitMismatchesFn mismatches;
+    OrbitClassMismatchesFn classMismatches;
+    bool vectorized;
+};
+
+/// @returns all kernels this CPU can run, fastest first. Last one is always scalar
+std::vector<OrbitKernel> supportedOrbitKernels();
+
+/// @returns fastest kernel supported by this CPU, detected once
+const OrbitKernel& bestOrbitKernel();
+
+/// @returns @param perm in slot layout, padded with identity
+OrbitSlots toOrbitSlots(const MovePermutation& perm);
+
+#endif // ORBITKERNELS_H
@@ -0,0 +1,321 @@
+#include "patterndatabase.h"
+#include <easylogging++.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr char kPatternMagic[4] = {'C', 'F', 'P', 'D'};
+constexpr uint32_t kPatternVersion = 1;
+constexpr uint8_t kNoSlot = 0xFF;
+constexpr uint8_t kUnknownDistance = 0xF;
+constexpr uint8_t kCapsOrbit = 5;
+
+std::vector<Pattern> defaultPatterns(uint8_t numStickers) {
+    std::vector<Pattern> result;
+    // step between stickers of different pieces: 3 for corners, 2 for edges. Stickers are
+    // taken one per piece first, so the first patterns track as many pieces as they can
+    const auto addOrbit = [&](const std::string& name, uint8_t orbit, uint8_t step) {
+        std::vector<uint8_t> stickers;
+        for (uint8_t first = 0; first < step; ++first)
+            for (uint8_t s = first; s < kNumElemStickers; s += step)
+                stickers.push_back(s);
+        for (size_t i = 0; i < stickers.size(); i += numStickers) {
+            const size_t end = std::min(i + numStickers, stickers.size());
+            result.push_back({name + std::to_string(i / numStickers), orbit
+                              , std::vector<uint8_t>(stickers.begin() + i, stickers.begin() + end)});
+        }
+    };
+    addOrbit("corners", 0, 3);
+    addOrbit("edges", 1, 2);
+    addOrbit("xcenters", 2, 1);
+    addOrbit("tcenters", 3, 1);
+    addOrbit("wings", 4, 1);
+    return result;
+}
+
+// destinations[m][p] = position of the sticker at position p of @param orbit after move m
+static const std::array<StickersArray, kNumAllQtmMoves>& destinations(uint8_t orbit) {
+    static const auto tables = [] {
+        std::array<std::array<StickersArray, kNumAllQtmMoves>, kNumOrbits> result;
+        for (uint8_t orbit = 0; orbit < kNumOrbits; ++orbit) {
+            const uint8_t n = (kCapsOrbit == orbit) ? kNumSides : kNumElemStickers;
+            for (uint8_t m = 0; m < kNumAllQtmMoves; ++m) {
+                const StickersArray& map = CubeState::movePermutation(m)[orbit];
+                for (uint8_t i = 0; i < n; ++i)
+                    result[orbit][m][map[i]] = i;
+            }
+        }
+        return result;
+    }();
+    return tables[orbit];
+}
+
+uint64_t PatternDatabase::numEntries(const Pattern& pattern) {
+    const uint8_t numPositions = (kCapsOrbit == pattern.orbit) ? kNumSides : kNumElemStickers;
+    uint64_t result = 1;
+    for (size_t i = 0; i < pattern.stickers.size(); ++i)
+        result *= numPositions - i;
+    return result;
+}
+
+void PatternDatabase::setPattern(const Pattern& pattern) {
+    pattern_ = pattern;
+    numPositions_ = (kCapsOrbit == pattern.orbit) ? kNumSides : kNumElemStickers;
+    numEntries_ = numEntries(pattern);
+    slots_.fill(kNoSlot);
+    for (size_t i = 0; i < pattern.stickers.size(); ++i)
+        slots_[pattern.stickers[i]] = i;
+}
+
+uint64_t PatternDatabase::rank(const uint8_t* positions) const {
+    // mixed radix n, n-1, ...: digit i is the position among the ones still free
+    uint64_t result = 0;
+    uint32_t used = 0;
+    for (size_t i = 0; i < pattern_.stickers.size(); ++i) {
+        const uint8_t p = positions[i];
+        result = result * (numPositions_ - i) + p - __builtin_popcount(used & ((1u << p) - 1));
+        used |= 1u << p;
+    }
+    return result;
+}
+
+void PatternDatabase::unrank(uint64_t rank, uint8_t* positions) const {
+    const size_t k = pattern_.stickers.size();
+    uint8_t digits[kNumElemStickers];
+    for (size_t i = k; i-- > 0;) {
+        digits[i] = rank % (numPositions_ - i);
+        rank /= numPositions_ - i;
+    }
+    uint32_t used = 0;
+    for (size_t i = 0; i < k; ++i) {
+        uint8_t p = 0;
+        for (uint8_t free = digits[i] + 1; ; ++p)
+            if (0 == (used & (1u << p)) && 0 == --free)
+                break;
+        positions[i] = p;
+        used |= 1u << p;
+    }
+}
+
+PatternDatabase::PatternDatabase(const Pattern& pattern) {
+    LOG_IF(pattern.stickers.size() > kMaxPatternStickers, FATAL) << "pattern " << pattern.name
+        << " has more than " << int(kMaxPatternStickers) << " stickers";
+    setPattern(pattern);
+    const size_t k = pattern.stickers.size();
+    table_.assign((numEntries_ + 1) / 2, 0xFF);
+    distances_ = table_.data();
+    const auto set = [this](uint64_t rank, uint8_t distance) {
+        uint8_t& byte = table_[rank / 2];
+        byte = (rank % 2) ? ((byte & 0x0F) | (distance << 4)) : ((byte & 0xF0) | distance);
+    };
+
+    const auto& dest = destinations(pattern.orbit);
+    std::vector<uint32_t> frontier{uint32_t(rank(pattern.stickers.data()))};
+    set(frontier.front(), 0);
+    uint8_t positions[kNumElemStickers];
+    uint8_t moved[kNumElemStickers];
+    for (uint8_t distance = 1; !frontier.empty(); ++distance) {
+        LOG_IF(distance >= kUnknownDistance, FATAL) << "pattern " << pattern.name
+            << " is too far from solved for 4-bit distances";
+        std::vector<uint32_t> next;
+        for (uint32_t r: frontier) {
+            unrank(r, positions);
+            for (uint8_t m = 0; m < kNumAllQtmMoves; ++m) {
+                for (size_t i = 0; i < k; ++i)
+                    moved[i] = dest[m][positions[i]];
+                const uint64_t movedRank = rank(moved);
+                if (kUnknownDistance == get(movedRank)) {
+                    set(movedRank, distance);
+                    next.push_back(movedRank);
+                }
+            }
+        }
+        frontier.swap(next);
+    }
+}
+
+PatternDatabase::PatternDatabase(const std::string& path, bool hugePages) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || 0 != fstat(fd, &st)) {
+        error_ = "can't open " + path;
+        if (fd >= 0)
+            ::close(fd);
+        return;
+    }
+    size_ = st.st_size;
+    if (size_ >= sizeof(PatternDatabaseHeader))
+        data_ = mmap(nullptr, size_, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (nullptr == data_ || MAP_FAILED == data_) {
+        data_ = nullptr;
+        error_ = path + " is not a pattern database";
+        return;
+    }
+#ifdef MADV_HUGEPAGE
+    if (hugePages && 0 != madvise(data_, size_, MADV_HUGEPAGE))
+        LOG(WARNING) << "huge pages are not available for " << path;
+#endif
+
+    PatternDatabaseHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    Pattern pattern{std::filesystem::path(path).stem().string(), header.orbit
+                    , std::vector<uint8_t>(header.stickers, header.stickers + header.numStickers)};
+    const bool headerIsValid = 0 == std::memcmp(header.magic, kPatternMagic, 4)
+        && kPatternVersion == header.version && header.orbit < kNumOrbits
+        && header.numStickers > 0 && header.numStickers <= header.numPositions
+        && header.numPositions == ((kCapsOrbit == header.orbit) ? kNumSides : kNumElemStickers)
+        && std::all_of(pattern.stickers.begin(), pattern.stickers.end()
+                       , [&header](uint8_t s) {return s < header.numPositions;});
+    if (!headerIsValid) {
+        error_ = path + " is not a pattern database";
+        return;
+    }
+    setPattern(pattern);
+    if (numEntries_ != header.numEntries
+        || size_ != sizeof(header) + (numEntries_ + 1) / 2) {
+        error_ = path + " is truncated or has unexpected size";
+        return;
+    }
+    distances_ = static_cast<const uint8_t*>(data_) + sizeof(header);
+}
+
+PatternDatabase::~PatternDatabase() {
+    if (nullptr != data_)
+        munmap(data_, size_);
+}
+
+PatternDatabase::PatternDatabase(PatternDatabase&& other) noexcept
+    : pattern_(std::move(other.pattern_))
+    , numPositions_(other.numPositions_)
+    , numEntries_(other.numEntries_)
+    , error_(std::move(other.error_))
+    , slots_(other.slots_)
+    , table_(std::move(other.table_))
+    , distances_(other.distances_)
+    , data_(other.data_)
+    , size_(other.size_)
+{
+    // vector move keeps the buffer, so distances_ stays valid for generated tables
+    other.distances_ = nullptr;
+    other.data_ = nullptr;
+}
+
+bool PatternDatabase::save(const std::string& path) const {
+    PatternDatabaseHeader header{};
+    std::memcpy(header.magic, kPatternMagic, 4);
+    header.version = kPatternVersion;
+    header.orbit = pattern_.orbit;
+    header.numStickers = pattern_.stickers.size();
+    header.numPositions = numPositions_;
+    std::copy(pattern_.stickers.begin(), pattern_.stickers.end(), header.stickers);
+    header.numEntries = numEntries_;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(distances_), (numEntries_ + 1) / 2);
+    if (!file.flush()) {
+        LOG(ERROR) << "failed to write " << path;
+        return false;
+    }
+    return true;
+}
+
+uint8_t PatternDatabase::distance(const CubeState& state) const {
+    uint8_t positions[kNumElemStickers];
+    for (uint8_t p = 0; p < numPositions_; ++p) {
+        const uint8_t slot = slots_[state.stickerAt(pattern_.orbit, p)];
+        if (kNoSlot != slot)
+            positions[slot] = p;
+    }
+    return get(rank(positions));
+}
+
+uint8_t PatternDatabase::distance(const uint8_t* stickerPositions) const {
+    uint8_t positions[kNumElemStickers];
+    for (size_t i = 0; i < pattern_.stickers.size(); ++i)
+        positions[i] = stickerPositions[pattern_.stickers[i]];
+    return get(rank(positions));
+}
+
+bool PatternDatabases::generate(const std::vector<Pattern>& patterns, std::string& error) {
+    // tables of all databases are kept, frontiers only while their database is built
+    uint64_t tables = 0, frontiers = 0;
+    for (const Pattern& pattern: patterns) {
+        if (pattern.stickers.size() > kMaxPatternStickers) {
+            error = "pattern " + pattern.name + " has more than "
+                    + std::to_string(kMaxPatternStickers) + " stickers";
+            return false;
+        }
+        // two frontiers of 4-byte ranks hold no more than all entries together
+        const uint64_t numEntries = PatternDatabase::numEntries(pattern);
+        tables += (numEntries + 1) / 2;
+        frontiers = std::max(frontiers, numEntries * sizeof(uint32_t));
+    }
+    const uint64_t memory = uint64_t(sysconf(_SC_PHYS_PAGES)) * uint64_t(sysconf(_SC_PAGE_SIZE));
+    if (tables + frontiers > memory) {
+        error = "pattern databases take up to " + std::to_string((tables + frontiers) >> 20)
+                + " MB to generate, more than " + std::to_string(memory >> 20)
+                + " MB of memory";
+        return false;
+    }
+    databases_.clear();
+    databases_.reserve(patterns.size());
+    for (const Pattern& pattern: patterns) {
+        databases_.emplace_back(pattern);
+        LOG(INFO) << "generated pattern database " << pattern.name << " ("
+                  << databases_.back().numEntries() << " entries)";
+    }
+    return true;
+}
+
+bool PatternDatabases::load(const std::string& dir, std::string& error, bool hugePages) {
+    databases_.clear();
+    std::vector<std::string> paths;
+    std::error_code ec;
+    for (const auto& entry: std::filesystem::directory_iterator(dir, ec))
+        if (entry.path().extension() == ".pdb")
+            paths.push_back(entry.path().string());
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        error = "no pattern databases (*.pdb) in " + dir;
+        return false;
+    }
+    for (const auto& path: paths) {
+        databases_.emplace_back(path, hugePages);
+        if (!databases_.back().error().empty()) {
+            error = databases_.back().error();
+            databases_.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PatternDatabases::save(const std::string& dir) const {
+    for (const auto& db: databases_)
+        if (!db.save((std::filesystem::path(dir) / (db.pattern().name + ".pdb")).string()))
+            return false;
+    return true;
+}
+
+uint8_t PatternDatabases::heuristic(const CubeState& state) const {
+    // databases of an orbit are next to each other (by name), its stickers are found once
+    uint8_t stickerPositions[kNumElemStickers];
+    uint8_t orbit = kNumOrbits;
+    uint8_t result = 0;
+    for (const auto& db: databases_) {
+        if (db.pattern().orbit != orbit) {
+            orbit = db.pattern().orbit;
+            for (uint8_t p = 0; p < db.numPositions(); ++p)
+                stickerPositions[state.stickerAt(orbit, p)] = p;
+        }
+        result = std::max(result, db.distance(stickerPositions));
+    }
+    return result;
+}
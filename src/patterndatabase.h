@@ -0,0 +1,135 @@
+#ifndef PATTERNDATABASE_H
+#define PATTERNDATABASE_H
+#include "cubestate.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Pattern databases: for every placement of a few stickers of one orbit, the exact number of
+// moves that brings them home. No sequence solves the cube in fewer moves than any of its
+// patterns, so the greatest lookup is an admissible heuristic for IDA*. Lookups can't be added
+// up: a move turns stickers of every pattern of its layers at once.
+// File layout (native byte order):
+//   PatternDatabaseHeader
+//   distances[numEntries], 4 bits each (low nibble first), indexed by the rank of the positions
+//       of the pattern stickers as an ordered selection out of numPositions
+
+struct PatternDatabaseHeader {
+    char magic[4];
+    uint32_t version;
+    uint8_t orbit;
+    uint8_t numStickers;
+    uint8_t numPositions;
+    uint8_t reserved[5];
+    uint8_t stickers[kNumElemStickers];
+    uint64_t numEntries;
+    uint8_t reserved2[16];
+};
+
+static_assert(sizeof(PatternDatabaseHeader) == 64, "pattern database layout");
+
+// number of stickers tracked by each database of defaultPatterns()
+constexpr uint8_t kDefaultPatternStickers = 5;
+
+// 24*23*...*18 = 1.7e9 placements of 7 stickers are ranked by 32 bits during generation; 8 would
+// take 2.96e10 ranks and 15 GB per database
+constexpr uint8_t kMaxPatternStickers = 7;
+
+// stickers of one orbit whose positions are the database coordinate
+struct Pattern {
+    std::string name;              // file name of the database, e.g. "corners"
+    uint8_t orbit;                 // corners, edges, x-centers, t-centers, wings
+    std::vector<uint8_t> stickers; // tracked stickers, solved sticker i is at position i
+};
+
+/// @returns patterns of corners, edges, wings, x- and t-centers of @param numStickers stickers
+/// (the last pattern of an orbit may have fewer), named e.g. "corners0". Together they cover
+/// every sticker of the orbit, so no displaced piece goes unseen, as it would by a single
+/// pattern per orbit (h = 5 instead of 7 for [L, U' R U], 60x slower IDA*).
+/// Caps are left out as isSolved() doesn't check them
+std::vector<Pattern> defaultPatterns(uint8_t numStickers = kDefaultPatternStickers);
+
+class PatternDatabase {
+public:
+    /// builds the database of @param pattern (up to kMaxPatternStickers stickers) by a
+    /// breadth-first search from the solved state
+    explicit PatternDatabase(const Pattern& pattern);
+
+    /// memory-maps database file @param path written by save(). Check error() afterwards
+    /// @param hugePages - advise the kernel to back the mapping with huge pages
+    PatternDatabase(const std::string& path, bool hugePages);
+
+    ~PatternDatabase();
+    PatternDatabase(PatternDatabase&& other) noexcept;
+    PatternDatabase(const PatternDatabase&) = delete;
+    PatternDatabase& operator=(const PatternDatabase&) = delete;
+    PatternDatabase& operator=(PatternDatabase&&) = delete;
+
+    /// @returns false and logs an error if the file can't be written
+    bool save(const std::string& path) const;
+
+    /// @returns number of moves needed to bring pattern stickers of @param state home
+    uint8_t distance(const CubeState& state) const;
+
+    /// same, from @param stickerPositions[s] = position of sticker s of the pattern's orbit
+    uint8_t distance(const uint8_t* stickerPositions) const;
+
+    const Pattern& pattern() const {return pattern_;}
+
+    /// @returns number of placements of the pattern stickers
+    uint64_t numEntries() const {return numEntries_;}
+
+    /// @returns number of placements of the stickers of @param pattern
+    static uint64_t numEntries(const Pattern& pattern);
+
+    /// @returns number of positions of the pattern's orbit
+    uint8_t numPositions() const {return numPositions_;}
+
+    /// @returns description of the problem with the loaded file or empty string if it's ok
+    const std::string& error() const {return error_;}
+
+private:
+    Pattern pattern_;
+    uint8_t numPositions_ = 0;
+    uint64_t numEntries_ = 0;
+    std::string error_;
+    // slots_[sticker] = index of sticker in pattern_.stickers or kNoSlot
+    std::array<uint8_t, kNumElemStickers> slots_{};
+    std::vector<uint8_t> table_; // generated distances
+    const uint8_t* distances_ = nullptr;
+    void* data_ = nullptr;       // mapped file
+    size_t size_ = 0;
+
+    void setPattern(const Pattern& pattern);
+    uint64_t rank(const uint8_t* positions) const;
+    void unrank(uint64_t rank, uint8_t* positions) const;
+    uint8_t get(uint64_t rank) const {return (distances_[rank / 2] >> (4 * (rank % 2))) & 0xF;}
+};
+
+// databases used together, the heuristic is the greatest of their distances
+class PatternDatabases {
+public:
+    /// builds databases of @param patterns. Takes ~2 min for 5-sticker defaultPatterns()
+    /// @returns false if a pattern has more than kMaxPatternStickers stickers or the databases
+    /// don't fit in physical memory, described in @param error. Nothing is built then
+    bool generate(const std::vector<Pattern>& patterns, std::string& error);
+
+    /// memory-maps all <name>.pdb files of @param dir
+    /// @returns false if there are none or some is broken, described in @param error
+    bool load(const std::string& dir, std::string& error, bool hugePages = false);
+
+    /// writes <name>.pdb files to @param dir
+    bool save(const std::string& dir) const;
+
+    /// @returns lower bound of the number of moves that solve @param state
+    uint8_t heuristic(const CubeState& state) const;
+
+    const std::vector<PatternDatabase>& databases() const {return databases_;}
+
+private:
+    std::vector<PatternDatabase> databases_;
+};
+
+#endif // PATTERNDATABASE_H
@@ -0,0 +1,40 @@
+#include <easylogging++.h>
+#include <filesystem>
+#include <iostream>
+
+#include "patterndatabase.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+static int showUsage(char* name) {
+    std::cerr << "Usage: " << name << " output_dir [stickers_per_pattern]\n"
+        << "\tgenerates pattern databases of the IDA* solver (corners, edges, wings, x- and"
+        << " t-centers) to output_dir/*.pdb\n"
+        << "\tstickers_per_pattern: 1.." << int(kMaxPatternStickers) << ", default "
+        << int(kDefaultPatternStickers) << ". Each extra sticker takes ~20x more memory and time"
+        << std::endl;
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Format, "%datetime %level %msg");
+
+    if (argc < 2 || argc > 3 || std::string(argv[1]) == "-h")
+        return showUsage(argv[0]);
+    const int numStickers = (3 == argc) ? std::stoi(argv[2]) : kDefaultPatternStickers;
+    if (numStickers < 1 || numStickers > kMaxPatternStickers)
+        return showUsage(argv[0]);
+
+    PatternDatabases databases;
+    std::string error;
+    if (!databases.generate(defaultPatterns(numStickers), error)) {
+        LOG(ERROR) << error;
+        return -1;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(argv[1], ec);
+    if (!databases.save(argv[1]))
+        return -1;
+    LOG(INFO) << "Saved " << databases.databases().size() << " pattern databases to " << argv[1];
+    return 0;
+}
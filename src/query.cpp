@@ -0,0 +1,107 @@
+#include <easylogging++.h>
+#include <iostream>
+#include <algorithm>
+#include <tuple>
+
+#include "resultindex.h"
+#include "cubestate.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+static int showUsage(char* name) {
+    std::cerr << "Usage: " << name << " index_path [--case case_type] [--cycles cycles]"
+        << " [--prefix cycles_prefix] [--element sticker] [--max-moves N] [--top N] [--count]\n"
+        << "\tprints results from the index of commfinder-index, shortest partB first\n"
+        << "\t--case: e.g. e3cycles, c22swaps, corner2Twists. All case types if omitted\n"
+        << "\t--cycles: exact cycles, e.g. UF-UB-UR or UF-UB.UL-UR. Any sticker names a piece\n"
+        << "\t--prefix: canonical cycles (each in its smallest orientation, from its smallest"
+        << " sticker) start with it\n"
+        << "\t--element: cycles include this piece, e.g. UF or FU. May be repeated\n"
+        << "\t--max-moves: partB has at most N moves\n"
+        << "\t--top: only N results with shortest partB\n"
+        << "\t--count: print number of results only"
+        << std::endl;
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Format, "%datetime %level %msg");
+
+    if (argc < 2 || std::string(argv[1]) == "-h")
+        return showUsage(argv[0]);
+    std::vector<CaseType> caseTypes;
+    std::string prefix;
+    bool exact = false;
+    std::vector<std::string> elements;
+    unsigned maxMoves = kMaxScrambleLength;
+    uint64_t top = UINT64_MAX;
+    bool countOnly = false;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        if (arg == "--case" && i + 1 < argc) {
+            caseTypes.push_back(caseTypeFromString(argv[++i]));
+            if (CaseType::caseTypeEnd == caseTypes.back())
+                return showUsage(argv[0]);
+        } else if (arg == "--cycles" && i + 1 < argc) {
+            std::string cycles(argv[++i]);
+            if (!cycles.empty() && '.' != cycles.back())
+                cycles += '.';
+            prefix = canonicalCycles(cycles);
+            exact = true;
+        } else if (arg == "--prefix" && i + 1 < argc) {
+            prefix = argv[++i];
+        } else if (arg == "--element" && i + 1 < argc) {
+            elements.emplace_back(argv[++i]);
+            if (pieceStickers(elements.back()).empty()) {
+                LOG(ERROR) << "unknown sticker " << elements.back() << ", e.g. UFR, Ufr, UFl";
+                return -1;
+            }
+        } else if (arg == "--max-moves" && i + 1 < argc) {
+            maxMoves = std::stoi(argv[++i]);
+        } else if (arg == "--top" && i + 1 < argc) {
+            top = std::stoull(argv[++i]);
+        } else if (arg == "--count") {
+            countOnly = true;
+        } else {
+            return showUsage(argv[0]);
+        }
+    }
+    const ResultIndex index(argv[1]);
+    if (!index.error().empty()) {
+        LOG(ERROR) << index.error();
+        return -1;
+    }
+    if (caseTypes.empty())
+        for (size_t i = 0; i < size_t(CaseType::caseTypeEnd); ++i)
+            caseTypes.push_back(CaseType(i));
+
+    // (partB size, key, record #) of matching results. Records of a key are sorted by partB
+    // size, so no more than top of them are taken from each key
+    std::vector<std::tuple<uint8_t, size_t, size_t>> found;
+    for (CaseType ct: caseTypes) {
+        const auto [first, last] = index.findKeys(ct, prefix);
+        for (size_t key = first; key < last; ++key) {
+            if (exact && index.cycles(key).size() != prefix.size())
+                continue;
+            if (!std::all_of(elements.begin(), elements.end(), [&](const std::string& e) {
+                    return cyclesHavePiece(index.cycles(key), e);}))
+                continue;
+            for (size_t i = 0; i < index.numRecords(key) && i < top
+                 && index.partBsize(key, i) <= maxMoves; ++i)
+                found.emplace_back(index.partBsize(key, i), key, i);
+        }
+    }
+    if (found.size() > top) {
+        std::stable_sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+            return std::get<0>(a) < std::get<0>(b);
+        });
+        found.resize(top);
+    }
+    if (countOnly) {
+        std::cout << found.size() << std::endl;
+        return 0;
+    }
+    for (const auto& [size, key, i]: found)
+        std::cout << index.text(key, i);
+    return 0;
+}
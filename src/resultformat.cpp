@@ -0,0 +1,201 @@
+#include "resultformat.h"
+#include "cubestate.h"
+#include "commutatorfinder.h"
+#include <algorithm>
+#include <array>
+
+// "CFRB", format version, record size, 2 reserved bytes
+constexpr char kMagic[] = "CFRB";
+constexpr uint8_t kFormatVersion = 1;
+constexpr unsigned kBitsPerMove = 6;
+static_assert(kNumAllQtmMoves <= (1u << kBitsPerMove), "move doesn't fit to record");
+static_assert(kBitsPerMove * kMaxScrambleLength <= 64, "partB doesn't fit to record");
+
+static void putUint32(std::string& s, uint32_t value) {
+    for (int i = 0; i < 4; ++i)
+        s.push_back(char(value >> (8 * i)));
+}
+
+static uint32_t getUint32(const char* data) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; --i)
+        value = (value << 8) | uint8_t(data[i]);
+    return value;
+}
+
+std::string resultFileHeader() {
+    std::string header(kMagic, 4);
+    header.push_back(char(kFormatVersion));
+    header.push_back(char(kResultRecordSize));
+    header.append(2, '\0');
+    return header;
+}
+
+std::string encodeRecord(const ResultRecord& record) {
+    const uint8_t size = numMoves(record.partB);
+    uint64_t moves = 0;
+    for (uint8_t i = 0; i < size; ++i)
+        moves |= uint64_t(record.partB[i]) << (kBitsPerMove * i);
+    std::string result;
+    result.reserve(kResultRecordSize);
+    for (int i = 0; i < 8; ++i)
+        result.push_back(char(moves >> (8 * i)));
+    result.push_back(char(record.partA));
+    result.push_back(char(size));
+    result.push_back(char(record.caseType));
+    result.push_back(char((record.centersReset ? 1 : 0) | (record.hasInertMove ? 2 : 0)));
+    return result;
+}
+
+bool decodeRecord(const char* data, ResultRecord& record) {
+    uint64_t moves = 0;
+    for (int i = 7; i >= 0; --i)
+        moves = (moves << 8) | uint8_t(data[i]);
+    record.partA = uint8_t(data[8]);
+    const uint8_t size = uint8_t(data[9]);
+    const uint8_t caseType = uint8_t(data[10]);
+    const uint8_t flags = uint8_t(data[11]);
+    if (record.partA >= kNumAllQtmMoves || 0 == size || size > kMaxScrambleLength
+            || caseType >= uint8_t(CaseType::caseTypeEnd) || flags > 3
+            || (size * kBitsPerMove < 64 && (moves >> (size * kBitsPerMove))))
+        return false;
+    record.partB = emptyMovesArray();
+    for (uint8_t i = 0; i < size; ++i) {
+        record.partB[i] = (moves >> (kBitsPerMove * i)) & ((1u << kBitsPerMove) - 1);
+        if (record.partB[i] >= kNumAllQtmMoves)
+            return false;
+    }
+    record.caseType = CaseType(caseType);
+    record.centersReset = (flags & 1);
+    record.hasInertMove = (flags & 2);
+    return true;
+}
+
+std::string resultBlock(std::string_view records) {
+    std::string block;
+    block.reserve(kResultBlockHeaderSize + records.size());
+    putUint32(block, records.size() / kResultRecordSize);
+    putUint32(block, crc32(records.data(), records.size()));
+    block.append(records);
+    return block;
+}
+
+std::string resultCycles(const ResultRecord& record) {
+    CubeState cube = commutator(CubeState::moveState(record.partA)
+                                , CubeState().applyScramble(record.partB));
+    if (record.centersReset)
+        cube.resetCenters();
+    return cube.solveAndGetCycles();
+}
+
+std::string resultToText(const ResultRecord& record) {
+    return resultCycles(record) + (record.centersReset ? "*: " : ": ")
+            + commutatorToString(record.partA, record.partB)
+            + (record.hasInertMove ? std::string(kInertMoveTag) : "") + "\n";
+}
+
+bool parseResultLine(std::string line, ResultRecord& record, std::string& cycles) {
+    record.hasInertMove = line.size() > kInertMoveTag.size()
+            && 0 == line.compare(line.size() - kInertMoveTag.size(), std::string::npos
+                                 , kInertMoveTag);
+    if (record.hasInertMove)
+        line.resize(line.size() - kInertMoveTag.size());
+    const size_t pos = line.find(": [");
+    if (std::string::npos == pos || line.back() != ']')
+        return false;
+    cycles = line.substr(0, pos);
+    record.centersReset = !cycles.empty() && '*' == cycles.back();
+    if (record.centersReset)
+        cycles.pop_back();
+    const std::string comm = line.substr(pos + 3, line.size() - pos - 4);
+    const size_t comma = comm.find(", ");
+    if (std::string::npos == comma)
+        return false;
+    record.partA = stringToMove(comm.substr(0, comma));
+    const std::string partB = comm.substr(comma + 2);
+    if (kNoMove == record.partA
+            || size_t(std::count(partB.begin(), partB.end(), ' ')) >= kMaxScrambleLength)
+        return false;
+    record.partB = stringToMoves(partB);
+    if (0 == numMoves(record.partB))
+        return false;
+    for (uint8_t i = 0, n = numMoves(record.partB); i < kMaxScrambleLength; ++i)
+        if ((i < n) == (kNoMove == record.partB[i]))
+            return false;
+    return true;
+}
+
+uint32_t crc32(const char* data, size_t size) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ uint8_t(data[i])) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+ResultReader::ResultReader(const std::string& path):
+    file_(path, std::ios::binary)
+  , path_(path)
+{
+    if (!file_) {
+        error_ = "can't open " + path;
+        return;
+    }
+    std::string header(kResultFileHeaderSize, '\0');
+    // empty file: search found nothing
+    if (!file_.read(header.data(), header.size()) && 0 == file_.gcount())
+        return;
+    if (header != resultFileHeader())
+        error_ = path + " is not a commfinder binary results file";
+}
+
+bool ResultReader::readBlock(std::string& records) {
+    if (!error_.empty() || !file_)
+        return false;
+    char header[kResultBlockHeaderSize];
+    if (!file_.read(header, sizeof(header))) {
+        if (0 != file_.gcount())
+            error_ = path_ + ": truncated block #" + std::to_string(numBlocks_);
+        return false;
+    }
+    const uint32_t numRecords = getUint32(header);
+    if (0 == numRecords || numRecords > kMaxRecordsPerBlock) {
+        error_ = path_ + ": bad header of block #" + std::to_string(numBlocks_);
+        return false;
+    }
+    records.resize(numRecords * kResultRecordSize);
+    if (!file_.read(records.data(), records.size())) {
+        error_ = path_ + ": truncated block #" + std::to_string(numBlocks_);
+        return false;
+    }
+    if (crc32(records.data(), records.size()) != getUint32(header + 4)) {
+        error_ = path_ + ": checksum mismatch in block #" + std::to_string(numBlocks_);
+        return false;
+    }
+    ++numBlocks_;
+    return true;
+}
+
+bool ResultReader::next(ResultRecord& record) {
+    if (blockPos_ == block_.size()) {
+        blockPos_ = 0;
+        block_.clear();
+        if (!readBlock(block_))
+            return false;
+    }
+    if (!decodeRecord(block_.data() + blockPos_, record)) {
+        error_ = path_ + ": bad record in block #" + std::to_string(numBlocks_ - 1);
+        return false;
+    }
+    blockPos_ += kResultRecordSize;
+    return true;
+}
@@ -0,0 +1,88 @@
+#ifndef RESULTFORMAT_H
+#define RESULTFORMAT_H
+#include "cube_moves.h"
+#include "searchcriteria.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Binary results file: header, then blocks. Block is (number of records, CRC-32 of records)
+// followed by the records. Each record is kResultRecordSize bytes, integers are little-endian:
+//   bytes 0-7: partB moves, 6 bits each, first move in the lowest bits
+//   byte 8: partA, byte 9: number of partB moves, byte 10: CaseType,
+//   byte 11: flags, bit 0 - centersReset, bit 1 - hasInertMove
+// Cycles aren't stored: they are computed from the commutator on export
+
+/// one result of the commutator search
+struct ResultRecord {
+    uint8_t partA;
+    MovesArray partB;
+    CaseType caseType;
+    bool centersReset; // centers cycles are omitted; text result has "*: " delimeter
+    bool hasInertMove = false; // text result is tagged with kInertMoveTag
+};
+
+/// text results with an inert partB move (see InertMoves::Tag) end with it
+constexpr std::string_view kInertMoveTag = " (inert)";
+
+constexpr size_t kResultRecordSize = 12;
+constexpr size_t kResultFileHeaderSize = 8;
+constexpr size_t kResultBlockHeaderSize = 8;
+/// records are written in blocks of this size, the last one and checkpoints may be shorter
+constexpr uint32_t kMaxRecordsPerBlock = 4096;
+
+/// @returns header that starts every binary results file
+std::string resultFileHeader();
+
+/// @returns @param record encoded as kResultRecordSize bytes
+std::string encodeRecord(const ResultRecord& record);
+
+/// decodes kResultRecordSize bytes at @param data to @param record
+/// @returns false if these bytes are not a valid record
+bool decodeRecord(const char* data, ResultRecord& record);
+
+/// @returns block of @param records (concatenated encoded records) with its header
+std::string resultBlock(std::string_view records);
+
+/// @returns cycles of @param record as the text output lists them, e.g. "UF-UB-UR."
+std::string resultCycles(const ResultRecord& record);
+
+/// @returns line of the text output for @param record (with "\n"), same as the search
+/// writes when the output isn't binary
+std::string resultToText(const ResultRecord& record);
+
+/// parses text result @param line "cycles[*]: [A, B][ (inert)]" to @param record (all but
+/// caseType) and its @param cycles
+/// @returns false if the line isn't a result
+bool parseResultLine(std::string line, ResultRecord& record, std::string& cycles);
+
+/// @returns CRC-32 (IEEE 802.3) of @param size bytes at @param data
+uint32_t crc32(const char* data, size_t size);
+
+/// reads binary results file block by block, checking checksums
+class ResultReader {
+public:
+    explicit ResultReader(const std::string& path);
+
+    /// reads next block of encoded records to @param records
+    /// @returns false if the file is over or broken, see error()
+    bool readBlock(std::string& records);
+
+    /// reads next record to @param record
+    /// @returns false if the file is over or broken, see error()
+    bool next(ResultRecord& record);
+
+    /// @returns description of the problem with the file or empty string if there's none
+    const std::string& error() const {return error_;}
+
+private:
+    std::ifstream file_;
+    std::string path_;
+    std::string error_;
+    std::string block_;
+    size_t blockPos_ = 0;
+    uint64_t numBlocks_ = 0;
+};
+
+#endif // RESULTFORMAT_H
@@ -0,0 +1,290 @@
+#include "resultindex.h"
+#include "cubestate.h"
+#include "commutatorfinder.h"
+#include "helpers.h"
+#include <easylogging++.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr char kIndexMagic[4] = {'C', 'F', 'I', 'X'};
+constexpr uint32_t kIndexVersion = 2;
+
+std::string canonicalCycles(std::string_view cycles) {
+    std::vector<std::string> canonical;
+    for (const auto& cycle: splitString(std::string(cycles), '.')) {
+        if (cycle.empty())
+            continue;
+        const StringVec stickers = splitString(cycle, '-');
+        std::vector<StringVec> pieces;
+        for (const auto& sticker: stickers) {
+            pieces.push_back(pieceStickers(sticker));
+            if (pieces.back().empty())
+                pieces.back().push_back(sticker);
+        }
+        // all stickers of a cycle are of the same orbit, so their pieces have as many stickers
+        std::string best;
+        for (size_t t = 0; t < pieces[0].size(); ++t) {
+            StringVec twisted;
+            for (const auto& piece: pieces)
+                twisted.push_back(piece[t % piece.size()]);
+            std::rotate(twisted.begin(), std::min_element(twisted.begin(), twisted.end())
+                        , twisted.end());
+            const std::string candidate = joinStrings(twisted, '-') + ".";
+            if (best.empty() || candidate < best)
+                best = candidate;
+        }
+        canonical.push_back(best);
+    }
+    std::sort(canonical.begin(), canonical.end());
+    std::string result;
+    for (const auto& cycle: canonical)
+        result += cycle;
+    return result;
+}
+
+bool cyclesHavePiece(std::string_view cycles, std::string_view sticker) {
+    StringVec stickers = pieceStickers(sticker);
+    if (stickers.empty())
+        stickers.emplace_back(sticker);
+    for (const auto& element: stickers) {
+        for (size_t pos = cycles.find(element); std::string_view::npos != pos
+             ; pos = cycles.find(element, pos + 1)) {
+            const size_t end = pos + element.size();
+            if ((0 == pos || '-' == cycles[pos - 1] || '.' == cycles[pos - 1])
+                    && (end == cycles.size() || '-' == cycles[end] || '.' == cycles[end]))
+                return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+// result read by the index builder
+struct IndexEntry {
+    uint32_t key;
+    uint8_t partBsize;
+    std::array<char, kResultRecordSize> record;
+};
+
+class IndexBuilder {
+public:
+    IndexBuilder(): criteria_(true, CenterSafety::SolvedCenterSafe) {
+        criteria_.set(CaseType::allSolved, true);
+    }
+
+    void add(const ResultRecord& record, std::string_view cycles) {
+        const std::string canonical = canonicalCycles(cycles);
+        std::string id = char(record.caseType) + canonical;
+        auto [itr, isNew] = keyIds_.emplace(std::move(id), uint32_t(keys_.size()));
+        if (isNew)
+            keys_.emplace_back(record.caseType, canonical);
+        IndexEntry entry{itr->second, numMoves(record.partB), {}};
+        const std::string encoded = encodeRecord(record);
+        std::copy(encoded.begin(), encoded.end(), entry.record.begin());
+        entries_.push_back(entry);
+    }
+
+    // @returns false if @param line isn't a result "cycles[*]: [A, B]"
+    bool addTextLine(const std::string& line) {
+        ResultRecord record;
+        std::string cycles;
+        if (!parseResultLine(line, record, cycles))
+            return false;
+        const CubeState cube = commutator(CubeState::moveState(record.partA)
+                                          , CubeState().applyScramble(record.partB));
+        record.caseType = cube.getCaseType(criteria_);
+        if (CaseType::caseTypeEnd == record.caseType)
+            return false;
+        add(record, cycles);
+        return true;
+    }
+
+    int64_t write(const std::string& path, std::string& error) {
+        // keys order, then records grouped by key in that order, shortest partB first
+        std::vector<uint32_t> order(keys_.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+            return keys_[a] < keys_[b];
+        });
+        std::vector<uint32_t> rank(keys_.size());
+        for (uint32_t i = 0; i < order.size(); ++i)
+            rank[order[i]] = i;
+        std::stable_sort(entries_.begin(), entries_.end()
+                         , [&rank](const IndexEntry& a, const IndexEntry& b) {
+            return rank[a.key] != rank[b.key] ? rank[a.key] < rank[b.key]
+                                              : a.partBsize < b.partBsize;
+        });
+
+        IndexHeader header{};
+        std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+        header.version = kIndexVersion;
+        header.numKeys = keys_.size();
+        header.numRecords = entries_.size();
+        std::vector<IndexKey> keys(keys_.size(), IndexKey{});
+        std::string cycles;
+        for (uint32_t i = 0; i < order.size(); ++i) {
+            const auto& [caseType, keyCycles] = keys_[order[i]];
+            if (cycles.size() > UINT32_MAX || keyCycles.size() > UINT16_MAX) {
+                error = "cycles of the results don't fit to the index: " + keyCycles.substr(0, 80);
+                return -1;
+            }
+            keys[i].caseType = uint8_t(caseType);
+            keys[i].cyclesOffset = cycles.size();
+            keys[i].cyclesSize = keyCycles.size();
+            cycles += keyCycles;
+        }
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            IndexKey& key = keys[rank[entries_[i].key]];
+            if (UINT32_MAX == key.numRecords) {
+                error = "too many results of cycles " + keys_[entries_[i].key].second;
+                return -1;
+            }
+            if (0 == key.numRecords++)
+                key.firstRecord = i;
+        }
+        header.cyclesSize = cycles.size();
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(IndexKey));
+        for (const auto& entry: entries_)
+            file.write(entry.record.data(), entry.record.size());
+        file.write("\0\0\0\0\0\0\0", (8 - entries_.size() * kResultRecordSize % 8) % 8);
+        file << cycles;
+        if (!file.flush()) {
+            error = "failed to write " + path;
+            return -1;
+        }
+        return entries_.size();
+    }
+
+private:
+    SearchCriteria criteria_;
+    std::unordered_map<std::string, uint32_t> keyIds_;
+    std::vector<std::pair<CaseType, std::string>> keys_;
+    std::vector<IndexEntry> entries_;
+};
+
+} // namespace
+
+int64_t buildResultIndex(const std::vector<std::string>& inputPaths, const std::string& indexPath
+                         , std::string& error) {
+    IndexBuilder builder;
+    for (const auto& path: inputPaths) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            error = "can't open " + path;
+            return -1;
+        }
+        std::string magic(4, '\0');
+        file.read(magic.data(), magic.size());
+        if (resultFileHeader().substr(0, 4) == magic) {
+            ResultReader reader(path);
+            for (ResultRecord record; reader.next(record);)
+                builder.add(record, resultCycles(record));
+            if (!reader.error().empty()) {
+                error = reader.error();
+                return -1;
+            }
+            continue;
+        }
+        file.clear();
+        file.seekg(0);
+        uint64_t numSkipped = 0;
+        for (std::string line; std::getline(file, line);)
+            numSkipped += !line.empty() && !builder.addTextLine(line);
+        LOG_IF(numSkipped > 0, WARNING) << "skipped " << numSkipped << " lines of " << path
+                                        << " that are not results of the default search";
+    }
+    return builder.write(indexPath, error);
+}
+
+ResultIndex::ResultIndex(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || 0 != fstat(fd, &st)) {
+        error_ = "can't open " + path;
+        if (fd >= 0)
+            ::close(fd);
+        return;
+    }
+    size_ = st.st_size;
+    if (size_ >= sizeof(IndexHeader))
+        data_ = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (nullptr == data_ || MAP_FAILED == data_) {
+        data_ = nullptr;
+        error_ = path + " is not a commfinder index";
+        return;
+    }
+    const auto& header = *static_cast<const IndexHeader*>(data_);
+    const uint64_t recordsSize = header.numRecords * kResultRecordSize;
+    const uint64_t recordsStart = sizeof(IndexHeader) + header.numKeys * sizeof(IndexKey);
+    const uint64_t cyclesStart = recordsStart + (recordsSize + 7) / 8 * 8;
+    if (0 != std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic))
+            || kIndexVersion != header.version || cyclesStart + header.cyclesSize != size_) {
+        error_ = path + " is not a commfinder index or is broken";
+        return;
+    }
+    numKeys_ = header.numKeys;
+    keys_ = reinterpret_cast<const IndexKey*>(static_cast<const char*>(data_)
+                                              + sizeof(IndexHeader));
+    records_ = static_cast<const char*>(data_) + recordsStart;
+    cycles_ = static_cast<const char*>(data_) + cyclesStart;
+}
+
+ResultIndex::~ResultIndex() {
+    if (nullptr != data_)
+        munmap(data_, size_);
+}
+
+std::string_view ResultIndex::cycles(size_t key) const {
+    return std::string_view(cycles_ + keys_[key].cyclesOffset, keys_[key].cyclesSize);
+}
+
+uint8_t ResultIndex::partBsize(size_t key, size_t i) const {
+    return uint8_t(records_[(keys_[key].firstRecord + i) * kResultRecordSize + 9]);
+}
+
+ResultRecord ResultIndex::record(size_t key, size_t i) const {
+    ResultRecord result;
+    decodeRecord(records_ + (keys_[key].firstRecord + i) * kResultRecordSize, result);
+    return result;
+}
+
+std::string ResultIndex::text(size_t key, size_t i) const {
+    const ResultRecord result = record(key, i);
+    return std::string(cycles(key)) + (result.centersReset ? "*: " : ": ")
+            + commutatorToString(result.partA, result.partB)
+            + (result.hasInertMove ? std::string(kInertMoveTag) : "") + "\n";
+}
+
+std::pair<size_t, size_t> ResultIndex::findKeys(CaseType ct, std::string_view cyclesPrefix) const {
+    // @returns first key in [first, numKeys_) for which @param isAfter is true
+    auto partitionPoint = [this](size_t first, auto isAfter) {
+        size_t last = numKeys_;
+        while (first < last) {
+            const size_t mid = first + (last - first) / 2;
+            if (isAfter(mid))
+                last = mid;
+            else
+                first = mid + 1;
+        }
+        return first;
+    };
+    const size_t first = partitionPoint(0, [&](size_t key) {
+        return caseType(key) > ct || (caseType(key) == ct && cycles(key) >= cyclesPrefix);
+    });
+    const size_t last = partitionPoint(first, [&](size_t key) {
+        return caseType(key) != ct || cycles(key).substr(0, cyclesPrefix.size()) != cyclesPrefix;
+    });
+    return {first, last};
+}
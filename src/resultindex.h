@@ -0,0 +1,96 @@
+#ifndef RESULTINDEX_H
+#define RESULTINDEX_H
+#include "resultformat.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Index of search results, memory-mapped for lookups without parsing. Results with the same
+// cycles form a key. Layout (native byte order, 8-byte aligned sections):
+//   IndexHeader
+//   IndexKey[numKeys], sorted by case type, then by canonical cycles
+//   records[numRecords] of kResultRecordSize bytes (resultformat.h), key by key; records of a
+//       key are sorted by partB length, so the shortest algs come first
+//   cycles of all keys, concatenated
+
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t numKeys;
+    uint64_t numRecords;
+    uint64_t cyclesSize;
+};
+
+struct IndexKey {
+    uint64_t firstRecord;
+    uint32_t numRecords;
+    uint32_t cyclesOffset;
+    uint16_t cyclesSize;
+    uint8_t caseType;
+    uint8_t reserved[5];
+};
+
+static_assert(sizeof(IndexHeader) == 32 && sizeof(IndexKey) == 24, "index layout");
+
+/// @returns @param cycles (e.g. "UB-UR-UF.DF-DB.") in canonical form: of all stickers of its
+/// pieces (see pieceStickers) each cycle is listed by the orientation and starting sticker that
+/// make it smallest, e.g. "BU-RU-FU.", cycles are sorted. Unknown stickers are kept as they are
+std::string canonicalCycles(std::string_view cycles);
+
+/// @returns true if @param cycles have any sticker of the piece with sticker @param sticker,
+/// e.g. for UFR, RUF or FRU
+bool cyclesHavePiece(std::string_view cycles, std::string_view sticker);
+
+/// reads results (text or binary files of commfinder) from @param inputPaths and writes their
+/// index to @param indexPath. Case types of text results are computed for the default search
+/// criteria; results that don't match them are skipped
+/// @returns number of indexed results or -1 on error, described in @param error, e.g. if a key
+/// has more records or cycles than the fields of IndexKey hold
+int64_t buildResultIndex(const std::vector<std::string>& inputPaths, const std::string& indexPath
+                         , std::string& error);
+
+/// read-only memory-mapped index written by buildResultIndex
+class ResultIndex {
+public:
+    explicit ResultIndex(const std::string& path);
+    ~ResultIndex();
+
+    ResultIndex(const ResultIndex&) = delete;
+    ResultIndex& operator=(const ResultIndex&) = delete;
+
+    /// @returns description of the problem with the index or empty string if it's ok
+    const std::string& error() const {return error_;}
+
+    size_t numKeys() const {return numKeys_;}
+    CaseType caseType(size_t key) const {return CaseType(keys_[key].caseType);}
+    std::string_view cycles(size_t key) const;
+    size_t numRecords(size_t key) const {return keys_[key].numRecords;}
+
+    /// @returns number of partB moves of record #@param i of @param key (no decoding)
+    uint8_t partBsize(size_t key, size_t i) const;
+
+    /// @returns record #@param i of @param key
+    ResultRecord record(size_t key, size_t i) const;
+
+    /// @returns record #@param i of @param key as a result line with the canonical cycles of
+    /// the key, e.g. "UB-UR-UF.: [R, U]\n". Unlike resultToText, doesn't rebuild the cube
+    std::string text(size_t key, size_t i) const;
+
+    /// @returns range [first, last) of keys of case @param ct whose canonical cycles start with
+    /// @param cyclesPrefix. Found by binary search
+    std::pair<size_t, size_t> findKeys(CaseType ct, std::string_view cyclesPrefix = "") const;
+
+private:
+    std::string error_;
+    void* data_ = nullptr;
+    size_t size_ = 0;
+    size_t numKeys_ = 0;
+    const IndexKey* keys_ = nullptr;
+    const char* records_ = nullptr;
+    const char* cycles_ = nullptr;
+};
+
+#endif // RESULTINDEX_H
@@ -0,0 +1,166 @@
+#include "resultwriter.h"
+#include "resultformat.h"
+#include <easylogging++.h>
+#include <unistd.h>
+using namespace std::chrono_literals;
+
+// each open file buffers this many bytes before writing to the OS
+constexpr size_t kFileBufferSize = 256 * 1024;
+
+ResultWriter::ResultWriter(size_t maxQueuedLines):
+    maxQueuedLines_(maxQueuedLines)
+  , thread_(&ResultWriter::run, this)
+{
+}
+
+ResultWriter::~ResultWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wakeWriter_.notify_all();
+    thread_.join();
+}
+
+void ResultWriter::write(const std::string& path, std::string line) {
+    push({path, std::move(line), false});
+}
+
+void ResultWriter::writeRecord(const std::string& path, std::string record) {
+    push({path, std::move(record), true});
+}
+
+void ResultWriter::push(Entry entry) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    wakeWaiters_.wait(lock, [this] {return queue_.size() < maxQueuedLines_;});
+    queue_.push_back(std::move(entry));
+    if (1 == queue_.size())
+        wakeWriter_.notify_one();
+}
+
+void ResultWriter::flush(bool sync) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // wait for a previous request to be taken, then for ours to be done
+    wakeWaiters_.wait(lock, [this] {return Request::None == request_;});
+    request_ = sync ? Request::Sync : Request::Flush;
+    wakeWriter_.notify_one();
+    wakeWaiters_.wait(lock, [this] {
+        return Request::None == request_ && queue_.empty() && !isWriting_;
+    });
+}
+
+void ResultWriter::closeFiles() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    wakeWaiters_.wait(lock, [this] {return Request::None == request_;});
+    request_ = Request::Close;
+    wakeWriter_.notify_one();
+    wakeWaiters_.wait(lock, [this] {
+        return Request::None == request_ && queue_.empty() && !isWriting_;
+    });
+}
+
+void ResultWriter::run() {
+    std::vector<Entry> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wakeWriter_.wait(lock, [this] {
+            return stop_ || !queue_.empty() || Request::None != request_;
+        });
+        // requests apply to lines queued before them, so the queue is written first
+        batch.swap(queue_);
+        const Request request = batch.empty() ? request_ : Request::None;
+        const bool stop = stop_ && batch.empty();
+        isWriting_ = true;
+        lock.unlock();
+        wakeWaiters_.notify_all(); // the queue has room again
+        writeEntries(batch);
+        batch.clear();
+        if (stop)
+            process(Request::Close);
+        else
+            process(request);
+        lock.lock();
+        isWriting_ = false;
+        if (Request::None != request)
+            request_ = Request::None;
+        wakeWaiters_.notify_all();
+        if (stop)
+            return;
+    }
+}
+
+void ResultWriter::writeEntries(const std::vector<Entry>& entries) {
+    for (const auto& entry: entries) {
+        if (!entry.isRecord) {
+            writeData(entry.path, entry.data);
+            continue;
+        }
+        PendingBlock& block = pendingBlocks_[entry.path];
+        block.records += entry.data;
+        if (++block.numRecords == kMaxRecordsPerBlock)
+            writeBlock(entry.path, block);
+    }
+}
+
+void ResultWriter::writeData(const std::string& path, std::string data
+                             , const std::string& header) {
+    bool hasHeader = header.empty();
+    size_t written = 0;
+    while (true) {
+        FILE* file = fileOf(path);
+        if (nullptr == file) {
+            LOG(ERROR) << "failed to open " << path << ". Retrying in 10s";
+            std::this_thread::sleep_for(10s);
+            continue;
+        }
+        if (!hasHeader && 0 == std::ftell(file))
+            data.insert(0, header);
+        hasHeader = true;
+        if (written == data.size())
+            return;
+        // a short write continues where it stopped. Nothing written at all (e.g. disk full)
+        // doesn't get better by retrying
+        const size_t size = std::fwrite(data.data() + written, 1, data.size() - written, file);
+        LOG_IF(0 == size, FATAL) << "failed to save to " << path;
+        written += size;
+    }
+}
+
+void ResultWriter::writeBlock(const std::string& path, PendingBlock& block) {
+    if (0 == block.numRecords)
+        return;
+    writeData(path, resultBlock(block.records), resultFileHeader());
+    block.records.clear();
+    block.numRecords = 0;
+}
+
+void ResultWriter::process(Request request) {
+    if (Request::None == request)
+        return;
+    for (auto& [path, block]: pendingBlocks_)
+        writeBlock(path, block);
+    pendingBlocks_.clear();
+    for (auto& [path, file]: files_) {
+        LOG_IF(0 != std::fflush(file), ERROR) << "failed to write " << path;
+        if (Request::Sync == request)
+            LOG_IF(0 != fsync(fileno(file)), ERROR) << "failed to sync " << path;
+        if (Request::Close == request)
+            std::fclose(file);
+    }
+    if (Request::Close == request)
+        files_.clear();
+}
+
+FILE* ResultWriter::fileOf(const std::string& path) {
+    auto itr = files_.find(path);
+    if (files_.end() != itr)
+        return itr->second;
+    FILE* file = std::fopen(path.c_str(), "ab");
+    if (nullptr == file)
+        return nullptr;
+    std::setvbuf(file, nullptr, _IOFBF, kFileBufferSize);
+    // position is used to tell if the file is empty
+    std::fseek(file, 0, SEEK_END);
+    files_.emplace(path, file);
+    return file;
+}
@@ -0,0 +1,94 @@
+#ifndef RESULTWRITER_H
+#define RESULTWRITER_H
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Appends lines to files from a dedicated thread, so that searching threads don't wait for
+// the disk. Lines are queued (the queue is bounded, a full queue blocks writers) and written
+// in batches. Every file is opened once and kept open with a large buffer.
+// Binary records (see resultformat.h) are framed into checksummed blocks
+class ResultWriter {
+public:
+    /// @param maxQueuedLines - number of lines write() can queue before it blocks
+    explicit ResultWriter(size_t maxQueuedLines = 1 << 16);
+
+    /// writes everything queued, closes files
+    ~ResultWriter();
+
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+
+    /// queues @param line to be appended to file @param path. Thread-safe
+    void write(const std::string& path, std::string line);
+
+    /// queues encoded @param record to be appended to binary results file @param path.
+    /// Records are written when a block is full or on flush(). Thread-safe
+    void writeRecord(const std::string& path, std::string record);
+
+    /// blocks until all lines and records queued so far are written to the OS
+    /// @param sync - also fsync the files, e.g. before saving a checkpoint
+    void flush(bool sync = false);
+
+    /// flushes and closes all files, e.g. before they are truncated.
+    /// Files are reopened by the next write()
+    void closeFiles();
+
+private:
+    enum class Request {None, Flush, Sync, Close};
+
+    struct Entry {
+        std::string path;
+        std::string data;
+        bool isRecord;
+    };
+
+    // records of a block that is not written yet
+    struct PendingBlock {
+        std::string records;
+        uint32_t numRecords = 0;
+    };
+
+    // queues entry, blocking while the queue is full
+    void push(Entry entry);
+
+    // writer thread loop
+    void run();
+
+    // writes batch of lines to their files, adds records to pending blocks
+    void writeEntries(const std::vector<Entry>& entries);
+
+    // writes @param data to file @param path, preceded by @param header if the file is empty.
+    // Retries until it succeeds
+    void writeData(const std::string& path, std::string data, const std::string& header = "");
+
+    // writes pending block of @param path, starting the file with a header if it's empty
+    void writeBlock(const std::string& path, PendingBlock& block);
+
+    // writes pending blocks, then runs request on all open files
+    void process(Request request);
+
+    // @returns file @param path opened for appending or nullptr on failure
+    FILE* fileOf(const std::string& path);
+
+    size_t maxQueuedLines_;
+    std::mutex mutex_;
+    std::condition_variable wakeWriter_, wakeWaiters_;
+    std::vector<Entry> queue_;
+    Request request_ = Request::None;
+    bool isWriting_ = false;
+    bool stop_ = false;
+
+    // open files and incomplete blocks, used by the writer thread only
+    std::unordered_map<std::string, FILE*> files_;
+    std::unordered_map<std::string, PendingBlock> pendingBlocks_;
+
+    std::thread thread_;
+};
+
+#endif // RESULTWRITER_H
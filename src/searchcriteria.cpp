@@ -24,6 +24,50 @@ CenterSafety SearchCriteria::getCenterSafety() const {
     return centerSafety_;
 }
 
+std::array<bool, kNumAllQtmMoves> SearchCriteria::relevantMoves() const {
+    std::array<bool, kNumAllQtmMoves> result{};
+    for (size_t i = 0; i < size_t(CaseType::caseTypeEnd); ++i) {
+        if (!cases_[i])
+            continue;
+        const auto moves = ::relevantMoves(CaseType(i));
+        for (uint8_t m = 0; m < kNumAllQtmMoves; ++m)
+            result[m] = result[m] || moves[m];
+    }
+    return result;
+}
+
+std::array<bool, kNumAllQtmMoves> relevantMoves(CaseType ct) {
+    // columns of scramblePermutations: c, e, x1, x2, t1, t2, w1, w2, caps
+    std::vector<uint8_t> columns;
+    switch (ct) {
+        case CaseType::c3cycles: case CaseType::c22swaps: case CaseType::c5cycles:
+        case CaseType::corner2Twists: case CaseType::corner3Twists: case CaseType::corner4Twists:
+            columns = {0};
+            break;
+        case CaseType::e3cycles: case CaseType::e22swaps: case CaseType::e5cycles:
+        case CaseType::edges2flips: case CaseType::edges4flips:
+            columns = {1};
+            break;
+        case CaseType::x3cycles: case CaseType::x22swaps: case CaseType::x5cycles:
+            columns = {2, 3};
+            break;
+        case CaseType::t3cycles: case CaseType::t22swaps: case CaseType::t5cycles:
+            columns = {4, 5};
+            break;
+        case CaseType::w3cycles: case CaseType::w22swaps: case CaseType::w2cycles:
+        case CaseType::w5cycles:
+            columns = {6, 7};
+            break;
+        default:
+            columns = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+    }
+    std::array<bool, kNumAllQtmMoves> result{};
+    for (uint8_t m = 0; m < kNumAllQtmMoves; ++m)
+        for (uint8_t column: columns)
+            result[m] = result[m] || !scramblePermutations[baseMove(m)][column].empty();
+    return result;
+}
+
 std::ostream& operator<<(std::ostream& oss, const CaseType& ct) {
     switch(ct) {
         case CaseType::c3cycles: return oss << "c3cycles";
@@ -58,3 +102,10 @@ std::string toString(CaseType ct) {
     oss << ct;
     return oss.str();
 }
+
+CaseType caseTypeFromString(std::string_view name) {
+    for (size_t i = 0; i < size_t(CaseType::caseTypeEnd); ++i)
+        if (toString(CaseType(i)) == name)
+            return CaseType(i);
+    return CaseType::caseTypeEnd;
+}
@@ -3,6 +3,9 @@
 
 #include <vector>
 #include <iostream>
+#include <array>
+#include <string_view>
+#include "cube_moves.h"
 
 enum class CenterSafety {
     IgnoreCenters,    // [U, M U' M] allowed,     [M, U2] allowed
@@ -24,6 +27,9 @@ enum class CaseType {
 std::ostream& operator<<(std::ostream& os, const CaseType& ct);
 std::string toString(CaseType ct);
 
+/// @returns CaseType named @param name (see toString(CaseType)) or caseTypeEnd if there's none
+CaseType caseTypeFromString(std::string_view name);
+
 /// @returns true if @param ct related to centers
 inline bool isCenterCaseType(CaseType ct) {
     return ct == CaseType::x3cycles || ct == CaseType::t3cycles
@@ -31,6 +37,11 @@ inline bool isCenterCaseType(CaseType ct) {
            || ct == CaseType::x5cycles || ct == CaseType::t5cycles;
 }
 
+/// @returns moves[m] = true if move m relocates elements of @param ct (e.g. corners for
+/// c3cycles), false for layers that don't hold them (M, l, b... for corners).
+/// All moves are relevant to allSolved
+std::array<bool, kNumAllQtmMoves> relevantMoves(CaseType ct);
+
 // elements: cextw
 class SearchCriteria {
 public:
@@ -45,6 +56,9 @@ public:
 
     CenterSafety getCenterSafety() const;
 
+    /// @returns moves relevant (see ::relevantMoves) to any of the active cases
+    std::array<bool, kNumAllQtmMoves> relevantMoves() const;
+
 private:
     // cases[i] = true if CaseType#i is active
     std::vector<bool> cases_;
@@ -0,0 +1,77 @@
+#include <easylogging++.h>
+#include <fstream>
+#include <iostream>
+
+#include "batchsolver.h"
+#include "patterndatabase.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+static int showUsage(char* name) {
+    std::cerr << "Usage: " << name << " results.txt [annotated.txt] [--pdb dir] [--threads N]"
+        << " [--max-moves N] [--moves R,U]\n"
+        << "\tappends the optimal number of moves of each commutator state to text results of"
+        << " commfinder, e.g. \" (optimal 8)\"\n"
+        << "\tannotated.txt: output file, standard output if omitted\n"
+        << "\t--pdb: pattern databases of commfinder-pdb, much faster solving\n"
+        << "\t--threads: number of states solved at once, default 1\n"
+        << "\t--max-moves: longer solutions aren't searched, \" (not found within N)\". Default "
+        << int(kDefaultMaxSolutionLength) << ". Each extra move takes ~17x more time\n"
+        << "\t--moves: optimal among solutions of these moves only, e.g. <R, U>. All by default"
+        << std::endl;
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Format, "%datetime %level %msg");
+
+    if (argc < 2 || std::string(argv[1]) == "-h")
+        return showUsage(argv[0]);
+    std::string outputPath, pdbDir;
+    unsigned numThreads = 1;
+    int maxMoves = kDefaultMaxSolutionLength;
+    MoveSet allowedMoves = allMoves();
+    bool validMoves = true;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        if (arg == "--pdb" && i + 1 < argc)
+            pdbDir = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc)
+            numThreads = std::stoul(argv[++i]);
+        else if (arg == "--max-moves" && i + 1 < argc)
+            maxMoves = std::stoi(argv[++i]);
+        else if (arg == "--moves" && i + 1 < argc)
+            validMoves = stringToMoveSet(argv[++i], allowedMoves);
+        else if (outputPath.empty() && arg.rfind("--", 0) != 0)
+            outputPath = arg;
+        else
+            return showUsage(argv[0]);
+    }
+    if (maxMoves < 1 || maxMoves > 20 || !validMoves)
+        return showUsage(argv[0]);
+
+    std::ifstream input(argv[1]);
+    LOG_IF(!input, FATAL) << "can't open file " << argv[1];
+    std::ofstream file;
+    if (!outputPath.empty()) {
+        file.open(outputPath, std::ios::trunc);
+        LOG_IF(!file, FATAL) << "can't open file " << outputPath << " for writing";
+    }
+    std::ostream& out = outputPath.empty() ? std::cout : file;
+
+    PatternDatabases databases;
+    if (!pdbDir.empty()) {
+        std::string error;
+        LOG_IF(!databases.load(pdbDir, error), FATAL) << error;
+    }
+    BatchSolver solver(pdbDir.empty() ? nullptr : &databases);
+    solver.setNumThreads(numThreads);
+    solver.setMaxSolutionLength(maxMoves);
+    solver.setAllowedMoves(allowedMoves);
+    const AnnotationCounts counts = annotateResults(input, out, solver);
+    out.flush();
+    LOG_IF(!out, FATAL) << "failed to write results";
+    LOG(INFO) << "Annotated " << counts.numResults << " results, " << counts.numNotFound
+              << " of them have no solution within " << maxMoves << " moves";
+    return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef WORKSTEALINGQUEUES_H
+#define WORKSTEALINGQUEUES_H
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Task queues of a fixed set of workers. Each worker takes tasks from the front of its own
+// queue (in the order they were pushed); when it runs dry, it steals from the back of the
+// others, so uneven tasks balance out. All tasks are pushed before the workers start
+template<class Task>
+class WorkStealingQueues {
+public:
+    explicit WorkStealingQueues(size_t numWorkers) {
+        for (size_t i = 0; i < numWorkers; ++i)
+            queues_.push_back(std::make_unique<Queue>());
+    }
+
+    /// adds @param task to the queue of @param worker
+    void push(size_t worker, const Task& task) {
+        Queue& queue = *queues_[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+
+    /// takes next task for @param worker into @param task
+    /// @returns false if all queues are empty
+    bool pop(size_t worker, Task& task) {
+        for (size_t i = 0; i < queues_.size(); ++i) {
+            Queue& queue = *queues_[(worker + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                continue;
+            if (0 == i) {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            } else {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    std::vector<std::unique_ptr<Queue>> queues_;
+};
+
+#endif // WORKSTEALINGQUEUES_H
@@ -4,6 +4,13 @@
 #include <thread>
 #include <chrono>
 #include <unordered_set>
+#include <unordered_map>
+#include <set>
+#include <sstream>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <filesystem>
 
 #include <bruteforcesolver.h>
 #include <cubestate.h>
@@ -12,6 +19,14 @@
 #include <incrementalscramble.h>
 #include <searchcriteria.h>
 #include <commutatorfinder.h>
+#include <orbitkernels.h>
+#include <cubesymmetry.h>
+#include <workstealingqueues.h>
+#include <resultwriter.h>
+#include <resultformat.h>
+#include <resultindex.h>
+#include <patterndatabase.h>
+#include <batchsolver.h>
 
 #include "testalgs.h"
 
@@ -86,6 +101,16 @@ TEST(Helpers, hasGroupedByButNotSorted) {
     ASSERT_FALSE(hasGroupedByButNotSorted(3, c1));
 }
 
+TEST(Helpers, hasFullBitGroup) {
+    ASSERT_FALSE(hasFullBitGroup(0, 3, 24));
+    ASSERT_TRUE(hasFullBitGroup(0b111000, 3, 24));
+    ASSERT_FALSE(hasFullBitGroup(0b011100, 3, 24)); // bits of two different groups
+    ASSERT_TRUE(hasFullBitGroup(0b1100, 2, 24));
+    ASSERT_FALSE(hasFullBitGroup(0b0110, 2, 24));
+    // bits past size are ignored
+    ASSERT_FALSE(hasFullBitGroup(uint32_t(0b111) << 24, 3, 24));
+}
+
 ////////////////////////////////////// cube_moves //////////////////////////////////////
 TEST(CubeMoves, Constants) {
     ASSERT_EQ(kNumElemStickers, 24);
@@ -162,6 +187,28 @@ TEST(CubeMoves, MovesStrings) {
     EXPECT_STREQ(toString(scr).c_str(), "L U R D");
 }
 
+TEST(CubeMoves, MoveSetStrings) {
+    MoveSet moves;
+    ASSERT_TRUE(stringToMoveSet("<R, U2>", moves));
+    EXPECT_TRUE(moves[stringToMove("R")]);
+    EXPECT_TRUE(moves[stringToMove("R2")]);
+    EXPECT_TRUE(moves[stringToMove("R'")]);
+    EXPECT_TRUE(moves[stringToMove("U2")]);
+    EXPECT_FALSE(moves[stringToMove("U")]);
+    EXPECT_FALSE(moves[stringToMove("L")]);
+    EXPECT_TRUE(isRestricted(moves));
+    EXPECT_EQ(toString(moves), "U2,R");
+
+    MoveSet parsed;
+    ASSERT_TRUE(stringToMoveSet("r,M,U',E2,D", parsed));
+    ASSERT_TRUE(stringToMoveSet(toString(parsed), moves));
+    EXPECT_EQ(moves, parsed);
+    EXPECT_FALSE(stringToMoveSet("R,X", moves));
+    EXPECT_FALSE(stringToMoveSet("R,Rw,U", moves)) << "wide moves aren't supported";
+    EXPECT_FALSE(stringToMoveSet("<>", moves));
+    EXPECT_FALSE(isRestricted(allMoves()));
+}
+
 
 
 TEST(CubeMoves, SameFace) {
@@ -235,6 +282,67 @@ TEST(CubeMoves, OppositeMoves) {
     ASSERT_NE(oppoMove(stringToMove("r")), stringToMove("R\'"));
 }
 
+////////////////////////////////////// orbitkernels //////////////////////////////////////
+TEST(OrbitKernels, AllKernelsMatchScalar) {
+    const auto kernels = supportedOrbitKernels();
+    ASSERT_FALSE(kernels.empty());
+    ASSERT_FALSE(kernels.back().vectorized);
+    const OrbitKernel& scalar = kernels.back();
+    for (const auto& kernel: kernels) {
+        alignas(kOrbitSlotSize) OrbitSlots expected = toOrbitSlots(CubeState::movePermutation(0));
+        alignas(kOrbitSlotSize) OrbitSlots actual = expected;
+        for (uint8_t move = 0; move < kNumAllQtmMoves; ++move) {
+            // maps with garbage in padding bytes must only use their lower 5 bits
+            alignas(kOrbitSlotSize) OrbitSlots map = toOrbitSlots(CubeState::movePermutation(move));
+            map[move % kNumOrbits][kOrbitSlotSize - 1] = 0xE0 | move % kOrbitSlotSize;
+            scalar.gather(expected[0].data(), map[0].data());
+            kernel.gather(actual[0].data(), map[0].data());
+            ASSERT_EQ(expected, actual) << kernel.name << ", " << moveToString(move);
+        }
+    }
+}
+
+TEST(OrbitKernels, ComparisonsMatchHelpers) {
+    std::mt19937 rng(42);
+    for (const auto& kernel: supportedOrbitKernels()) {
+        for (uint8_t groupSize: {2, 3}) {
+            std::array<uint8_t, kOrbitSlotSize> pieces;
+            for (uint8_t i = 0; i < kOrbitSlotSize; ++i)
+                pieces[i] = i / groupSize;
+            for (int n = 0; n < 1000; ++n) {
+                // some pieces twisted in place, some stickers swapped between pieces
+                StickersArray state;
+                std::iota(state.begin(), state.end(), 0);
+                for (int k = rng() % 4; k > 0; --k) {
+                    auto group = state.begin() + rng() % (kNumElemStickers / groupSize) * groupSize;
+                    std::rotate(group, group + 1, group + groupSize);
+                }
+                for (int k = rng() % 3; k > 0; --k)
+                    std::swap(state[rng() % kNumElemStickers], state[rng() % kNumElemStickers]);
+
+                // padding bytes are garbage
+                alignas(kOrbitSlotSize) std::array<uint8_t, kOrbitSlotSize> slot;
+                std::fill(slot.begin(), slot.end(), uint8_t(rng()));
+                std::copy(state.begin(), state.end(), slot.begin());
+                constexpr uint32_t kBits = (uint32_t(1) << kNumElemStickers) - 1;
+                const uint32_t mismatches = kernel.mismatches(slot.data()) & kBits;
+                const uint32_t classMismatches
+                        = kernel.classMismatches(slot.data(), pieces.data()) & kBits;
+                StickersArray identity;
+                std::iota(identity.begin(), identity.end(), 0);
+                ASSERT_EQ(__builtin_popcount(mismatches), numMismatches(state, identity))
+                        << kernel.name << " " << arrToString(state);
+                ASSERT_EQ(0 == classMismatches, areGroupedBy(groupSize, state))
+                        << kernel.name << " " << arrToString(state);
+                const uint32_t movedWithinPiece = ~classMismatches & mismatches;
+                ASSERT_EQ(hasFullBitGroup(movedWithinPiece, groupSize, kNumElemStickers),
+                          hasGroupedByButNotSorted(groupSize, state))
+                        << kernel.name << " " << arrToString(state);
+            }
+        }
+    }
+}
+
 ////////////////////////////////////// incrementalscramble //////////////////////////////
 TEST(IncrementalScramble, ItrScrGeneratesAllScrambles) {
     std::unordered_set<std::string> hash;
@@ -342,6 +450,87 @@ TEST(IncrementalScramble, ItrScrGeneratesAllScrambles) {
     }
 }
 
+TEST(IncrementalScramble, ItrScrOrderMatchesCounter) {
+    // IncrementalScramble visits exactly the non-redundant values of a base-45 counter whose
+    // first move is the least significant digit, in the order of the counter
+    IncrementalScramble is;
+    for (uint8_t size = 1; size <= 3; ++size) {
+        MovesArray counter = emptyMovesArray();
+        std::fill(counter.begin(), counter.begin() + size, 0);
+        while (true) {
+            bool isRedundant = false;
+            for (uint8_t j = 0; j + 1 < size; ++j)
+                isRedundant |= !canFollow(counter[j], counter[j+1]);
+            if (!isRedundant) {
+                ASSERT_EQ(toString(is.get()), toString(counter));
+                ++is;
+            }
+            uint8_t i = 0;
+            while (i < size && ++counter[i] == kNumAllQtmMoves)
+                counter[i++] = 0;
+            if (i == size)
+                break;
+        }
+    }
+    ASSERT_EQ(is.size(), 4);
+}
+
+TEST(IncrementalScramble, CountRankUnrank) {
+    for (uint8_t parallelTo: {kNoMove, stringToMove("L"), stringToMove("U2"), stringToMove("S`")}) {
+        IncrementalScramble is;
+        // initial "L" is visited even if it's parallel
+        if (kNoMove != parallelTo && areParallelLayersMoves(parallelTo, is.get()[0]))
+            is.incAndSkipParallelBeginEnd(parallelTo);
+        for (uint8_t size = 1; size <= 3; ++size) {
+            uint64_t index = 0;
+            for (; is.size() == size; ++index) {
+                const MovesArray& moves = is.get();
+                ASSERT_EQ(IncrementalScramble::rank(moves, parallelTo), index) << is.toString();
+                ASSERT_EQ(IncrementalScramble::unrank(size, index, parallelTo), moves) << index;
+                ASSERT_EQ(IncrementalScramble::count(size, parallelTo, moves[size-1])
+                          , IncrementalScramble::rank(IncrementalScramble::unrank(
+                                size, IncrementalScramble::count(size, parallelTo, moves[size-1])
+                                , parallelTo), parallelTo));
+                if (kNoMove == parallelTo)
+                    ++is;
+                else
+                    is.incAndSkipParallelBeginEnd(parallelTo);
+            }
+            ASSERT_EQ(IncrementalScramble::count(size, parallelTo), index) << int(size);
+        }
+    }
+    ASSERT_EQ(IncrementalScramble::count(1), kNumAllQtmMoves);
+    // no same face twice; "L R" is counted, "R L" is not: 3 axes of 5 layers, 3*3 turns each
+    ASSERT_EQ(IncrementalScramble::count(2)
+              , kNumAllQtmMoves * (kNumAllQtmMoves - 3) - 3 * (5*4/2) * (3*3));
+}
+
+TEST(IncrementalScramble, CounterSkipsOtherMoves) {
+    MoveSet moves;
+    ASSERT_TRUE(stringToMoveSet("R,U,r,M", moves));
+    const ScrambleCounter counter(moves);
+    for (uint8_t parallelTo: {kNoMove, stringToMove("R")}) {
+        IncrementalScramble is;
+        for (uint8_t size = 1; size <= 3; ++size) {
+            uint64_t index = 0;
+            for (; is.size() == size; ++is) {
+                const MovesArray& scramble = is.get();
+                if (kNoMove != parallelTo && (areParallelLayersMoves(scramble[0], parallelTo)
+                        || areParallelLayersMoves(scramble[size-1], parallelTo)))
+                    continue;
+                EXPECT_EQ(counter.rank(scramble, parallelTo), index) << is.toString();
+                if (std::all_of(scramble.begin(), scramble.begin() + size
+                                , [&moves](uint8_t m) {return moves[m];})) {
+                    EXPECT_EQ(counter.unrank(size, index, parallelTo), scramble);
+                    ++index;
+                }
+            }
+            EXPECT_EQ(counter.count(size, parallelTo), index) << int(size);
+        }
+    }
+    EXPECT_EQ(counter.count(1), 12u); // R, U, r, M: 3 turns each
+}
+
 TEST(IncrementalScramble, incAndSkipParallelL) {
     IncrementalScramble isL;
     std::unordered_set<std::string> hashNoL;
@@ -522,6 +711,124 @@ TEST(CubeStateTests, TrifleSolvesCube) {
     }
 }
 
+TEST(CubeStateTests, MoveTablesMatchCycles) {
+    for (uint8_t move = 0; move < kNumAllQtmMoves; ++move) {
+        CubeState byTable, byCycles;
+        byTable.applyScrambleMove(move);
+        byCycles.applyScrambleMoveByCycles(move);
+        ASSERT_EQ(byTable.toString(), byCycles.toString()) << moveToString(move);
+    }
+
+    for (const auto& p: test_algs::algsForCase) {
+        for (const auto& alg: p.second) {
+            CubeState byTable, byCycles;
+            byTable.applyStringScramble(alg);
+            for (const auto& move: splitString(alg, ' '))
+                byCycles.applyScrambleMoveByCycles(stringToMove(move));
+            ASSERT_EQ(byTable.toString(), byCycles.toString()) << alg;
+            ASSERT_EQ(byTable.getCaseType(SearchCriteria(true)),
+                      byCycles.getCaseType(SearchCriteria(true))) << alg;
+        }
+    }
+}
+
+TEST(CubeStateTests, MoveStatesAreCached) {
+    for (uint8_t move = 0; move < kNumAllQtmMoves; ++move) {
+        CubeState cube;
+        cube.applyScrambleMove(move);
+        ASSERT_EQ(cube.toString(), CubeState::moveState(move).toString()) << moveToString(move);
+        ASSERT_EQ(cube.centersAreSafe(), CubeState::moveState(move).centersAreSafe());
+    }
+}
+
+TEST(CubeStateTests, ComposeAndInverse) {
+    const std::string x = "R u M` F2 d";
+    const std::string y = "l E2 B` S";
+    auto xState = CubeState().applyStringScramble(x);
+    auto yState = CubeState().applyStringScramble(y);
+    auto xyState = CubeState().applyStringScramble(x + " " + y);
+    ASSERT_EQ(compose(xState, yState).toString(), xyState.toString());
+    ASSERT_NE(compose(yState, xState).toString(), xyState.toString());
+
+    auto xInverse = CubeState().applyStringScramble("d` F2 M u` R`");
+    ASSERT_EQ(inverse(xState).toString(), xInverse.toString());
+    ASSERT_TRUE(compose(xState, inverse(xState)).isSolved());
+    ASSERT_TRUE(compose(inverse(xState), xState).isSolved());
+    ASSERT_TRUE(inverse(CubeState()).isSolved());
+}
+
+TEST(CubeStateTests, ConjugateAndCommutator) {
+    const auto r = CubeState::moveState(stringToMove("R"));
+    const auto u = CubeState::moveState(stringToMove("U"));
+    auto sexy = CubeState().applyStringScramble(test_algs::kSexy);
+    ASSERT_EQ(commutator(r, u).toString(), sexy.toString());
+
+    auto setup = CubeState().applyStringScramble("D l");
+    auto conjugated = CubeState().applyStringScramble("D l " + test_algs::kSexy + " l` D`");
+    ASSERT_EQ(conjugate(sexy, setup).toString(), conjugated.toString());
+
+    SearchCriteria criteriaAll(true, CenterSafety::SolvedCenterSafe);
+    size_t numChecked = 0;
+    for (const auto& p: test_algs::algsForCase) {
+        for (const auto& alg: p.second) {
+            // A B A' B' where A is the first move and B is the rest of the first half
+            const auto moves = splitString(alg, ' ');
+            if (moves.size() < 4 || moves.size() % 2)
+                continue;
+            CubeState a = CubeState().applyStringScramble(moves.front());
+            StringVec bMoves(moves.begin() + 1, moves.begin() + moves.size() / 2);
+            CubeState b = CubeState().applyStringScramble(joinStrings(bMoves, ' '));
+            CubeState byMoves = CubeState().applyStringScramble(alg);
+            CubeState comm = commutator(a, b);
+            if (comm.toString() != byMoves.toString())
+                continue; // alg isn't a commutator of this shape
+            ASSERT_EQ(p.first, comm.getCaseType(criteriaAll)) << alg;
+            ASSERT_EQ(byMoves.centersAreSafe(), comm.centersAreSafe()) << alg;
+            ++numChecked;
+        }
+    }
+    EXPECT_EQ(numChecked, 13u) << "algs of test_algs::algsForCase in [A, B] shape";
+}
+
+TEST(CubeStateTests, HashDependsOnStickersOnly) {
+    CubeState cube;
+    for (uint8_t i = 0; i < 200; ++i) {
+        cube.applyScrambleMove(i * 7 % kNumAllQtmMoves);
+        // composing with solved state copies the stickers only, not the slot padding
+        const CubeState copy = compose(cube, CubeState());
+        ASSERT_EQ(cube.hash(), copy.hash()) << cube;
+        ASSERT_EQ(cube, copy);
+    }
+
+    // distinct states up to 2 moves from solved have distinct hashes
+    std::vector<std::string> states;
+    std::vector<uint64_t> hashes;
+    for (IncrementalScramble scramble; scramble.size() <= 2; ++scramble) {
+        const CubeState state = CubeState().applyScramble(scramble.get());
+        states.push_back(state.toString());
+        hashes.push_back(state.hash());
+    }
+    std::sort(states.begin(), states.end());
+    std::sort(hashes.begin(), hashes.end());
+    EXPECT_EQ(std::unique(hashes.begin(), hashes.end()) - hashes.begin()
+              , std::unique(states.begin(), states.end()) - states.begin());
+}
+
+TEST(CubeStateTests, HashAndEquality) {
+    CubeState rl = CubeState().applyStringScramble("R L");
+    CubeState lr = CubeState().applyStringScramble("L R");
+    CubeState ru = CubeState().applyStringScramble("R U");
+    ASSERT_EQ(rl, lr);
+    ASSERT_EQ(rl.hash(), lr.hash());
+    ASSERT_NE(rl, ru);
+    ASSERT_NE(rl.hash(), ru.hash());
+    ASSERT_EQ(CubeState().hash(), CubeState().applyStringScramble(test_algs::k2sexy + " "
+                + test_algs::k4sexy).hash());
+
+    std::unordered_set<CubeState> states{rl, lr, ru, CubeState(), CubeState().reset()};
+    ASSERT_EQ(states.size(), 3);
+}
+
 ////////////////////////////////////// SearchCriteria //////////////////////////////////////
 TEST(SearchCriteria, SearchCriteriaIntegrity) {
     SearchCriteria scTrue(true);
@@ -575,6 +882,190 @@ TEST(SearchCriteria, CubeMatchesCriteria2) {
 }
 
 
+TEST(SearchCriteria, RelevantMoves) {
+    const auto corners = relevantMoves(CaseType::c3cycles);
+    const auto wings = relevantMoves(CaseType::w3cycles);
+    for (uint8_t m = 0; m < kNumAllQtmMoves; ++m) {
+        EXPECT_EQ(corners[m], isOuterMove(m)) << moveToString(m);
+        EXPECT_EQ(wings[m], baseMove(m) < stringToMove("M")) << moveToString(m);
+    }
+    EXPECT_TRUE(relevantMoves(CaseType::e3cycles)[stringToMove("M'")]);
+    EXPECT_FALSE(relevantMoves(CaseType::e3cycles)[stringToMove("r2")]);
+    SearchCriteria criteria(false);
+    criteria.set(CaseType::corner2Twists, true);
+    EXPECT_EQ(criteria.relevantMoves(), corners);
+    criteria.set(CaseType::w22swaps, true);
+    EXPECT_EQ(criteria.relevantMoves(), wings);
+}
+
+////////////////////////////////////// cubesymmetry //////////////////////////////////////
+TEST(CubeSymmetry, MoveMaps) {
+    const auto& maps = symmetryMoveMaps();
+    std::vector<MoveMap> distinct(maps.begin(), maps.end());
+    std::sort(distinct.begin(), distinct.end());
+    ASSERT_EQ(std::unique(distinct.begin(), distinct.end()), distinct.end());
+    for (uint8_t move = 0; move < kNumAllQtmMoves; ++move)
+        ASSERT_EQ(maps[0][move], move);
+    for (const MoveMap& map: maps) {
+        MoveMap sorted = map;
+        std::sort(sorted.begin(), sorted.end());
+        MoveMap identity;
+        std::iota(identity.begin(), identity.end(), 0);
+        ASSERT_EQ(sorted, identity);
+    }
+
+    // L, L2, l, l2, M, M2 stand for all moves
+    std::unordered_set<uint8_t> representatives;
+    for (uint8_t move = 0; move < kNumAllQtmMoves; ++move)
+        representatives.insert(symmetryRepresentative(move));
+    ASSERT_EQ(representatives.size(), 6);
+    ASSERT_EQ(symmetryRepresentative(stringToMove("B`")), stringToMove("L"));
+    ASSERT_EQ(symmetryRepresentative(stringToMove("S2")), stringToMove("M2"));
+}
+
+TEST(CubeSymmetry, ImagesHaveSameCaseType) {
+    const SearchCriteria criteriaAll(true, CenterSafety::SolvedCenterSafe);
+    for (const auto& [caseType, algs]: test_algs::algsForCase) {
+        for (const auto& alg: algs) {
+            for (const MoveMap& map: symmetryMoveMaps()) {
+                std::string image;
+                for (const auto& move: splitString(alg, ' '))
+                    image += (image.empty() ? "" : " ") + moveToString(map[stringToMove(move)]);
+                ASSERT_EQ(caseType, CubeState().applyStringScramble(image)
+                          .getCaseType(criteriaAll)) << alg << " -> " << image;
+            }
+        }
+    }
+}
+
+TEST(CubeSymmetry, ParallelMovesStayOrdered) {
+    // mirror L <-> R: "L R2 U" -> "R' L2 U'" -> "L2 R' U'"
+    const MovesArray moves = stringToMoves("L R2 U");
+    for (const MoveMap& map: symmetryMoveMaps()) {
+        if (map[stringToMove("L")] != stringToMove("R`")
+                || map[stringToMove("U")] != stringToMove("U`"))
+            continue;
+        ASSERT_EQ(toString(applyMoveMap(map, moves)), "L2 R' U'");
+        return;
+    }
+    FAIL() << "no L <-> R mirror";
+}
+
+////////////////////////////////////// workstealingqueues //////////////////////////////////////
+TEST(WorkStealingQueues, EveryTaskIsTakenOnce) {
+    constexpr unsigned kNumWorkers = 4;
+    constexpr int kNumTasks = 10000;
+    WorkStealingQueues<int> queues(kNumWorkers);
+    // all tasks to one worker: the others only steal
+    for (int i = 0; i < kNumTasks; ++i)
+        queues.push(0, i);
+    std::vector<std::vector<int>> taken(kNumWorkers);
+    std::vector<std::thread> threads;
+    for (unsigned w = 0; w < kNumWorkers; ++w)
+        threads.emplace_back([&, w] {
+            for (int task; queues.pop(w, task);)
+                taken[w].push_back(task);
+        });
+    for (auto& thread: threads)
+        thread.join();
+    std::vector<int> all;
+    for (const auto& tasks: taken)
+        all.insert(all.end(), tasks.begin(), tasks.end());
+    std::sort(all.begin(), all.end());
+    ASSERT_EQ(all.size(), kNumTasks);
+    for (int i = 0; i < kNumTasks; ++i)
+        ASSERT_EQ(all[i], i);
+    int task;
+    ASSERT_FALSE(queues.pop(1, task));
+}
+
+////////////////////////////////////// resultwriter //////////////////////////////////////
+TEST(ResultWriter, WritesLinesOfEachThreadInOrder) {
+    constexpr int kNumThreads = 4;
+    constexpr int kNumLines = 5000;
+    const std::string paths[] = {"/tmp/commfinder_writer0.txt", "/tmp/commfinder_writer1.txt"};
+    for (const auto& path: paths)
+        ASSERT_TRUE(saveToFile(path, "", false));
+    // small queue: writers have to wait for it
+    ResultWriter writer(16);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumThreads; ++t)
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kNumLines; ++i)
+                writer.write(paths[t % 2], std::to_string(t) + " " + std::to_string(i) + "\n");
+        });
+    for (auto& thread: threads)
+        thread.join();
+    writer.flush(true);
+    std::vector<int> nextLine(kNumThreads, 0);
+    for (int f = 0; f < 2; ++f) {
+        std::istringstream contents(getFileContents(paths[f], true));
+        for (int t, i; contents >> t >> i;) {
+            ASSERT_EQ(f, t % 2);
+            ASSERT_EQ(nextLine[t]++, i);
+        }
+    }
+    for (int t = 0; t < kNumThreads; ++t)
+        ASSERT_EQ(nextLine[t], kNumLines);
+    // truncated file is reopened after closeFiles()
+    writer.closeFiles();
+    ASSERT_TRUE(saveToFile(paths[0], "", false));
+    writer.write(paths[0], "last\n");
+    writer.flush();
+    ASSERT_EQ(getFileContents(paths[0], true), "last\n");
+}
+
+////////////////////////////////////// resultformat //////////////////////////////////////
+TEST(ResultFormat, RecordRoundTrip) {
+    ResultRecord record{kNumAllQtmMoves - 1, emptyMovesArray(), CaseType::w5cycles, true};
+    for (uint8_t i = 0; i < kMaxScrambleLength; ++i)
+        record.partB[i] = kNumAllQtmMoves - 1 - i;
+    const std::string encoded = encodeRecord(record);
+    ASSERT_EQ(encoded.size(), kResultRecordSize);
+    ResultRecord decoded;
+    ASSERT_TRUE(decodeRecord(encoded.data(), decoded));
+    EXPECT_EQ(decoded.partA, record.partA);
+    EXPECT_EQ(decoded.partB, record.partB);
+    EXPECT_EQ(decoded.caseType, record.caseType);
+    EXPECT_EQ(decoded.centersReset, record.centersReset);
+
+    record.partB = emptyMovesArray();
+    std::string broken = encodeRecord(record);
+    EXPECT_FALSE(decodeRecord(broken.data(), decoded)) << "empty partB";
+    record.partB[0] = 0;
+    broken = encodeRecord(record);
+    broken[10] = char(CaseType::caseTypeEnd);
+    EXPECT_FALSE(decodeRecord(broken.data(), decoded)) << "bad case type";
+}
+
+TEST(ResultFormat, Crc32) {
+    const std::string check("123456789");
+    EXPECT_EQ(crc32(check.data(), check.size()), 0xCBF43926u);
+}
+
+TEST(ResultFormat, BrokenBlockIsDetected) {
+    const std::string path("/tmp/commfinder_broken.bin");
+    ResultRecord record{0, emptyMovesArray(), CaseType::c3cycles, false};
+    record.partB[0] = 1;
+    const std::string records = encodeRecord(record) + encodeRecord(record);
+    std::string contents = resultFileHeader() + resultBlock(records);
+    ASSERT_TRUE(saveToFile(path, contents, false));
+    {
+        ResultReader reader(path);
+        int numRecords = 0;
+        for (ResultRecord r; reader.next(r);)
+            ++numRecords;
+        EXPECT_EQ(numRecords, 2);
+        EXPECT_TRUE(reader.error().empty()) << reader.error();
+    }
+    contents[kResultFileHeaderSize + kResultBlockHeaderSize] ^= 1;
+    ASSERT_TRUE(saveToFile(path, contents, false));
+    ResultReader reader(path);
+    ResultRecord r;
+    EXPECT_FALSE(reader.next(r));
+    EXPECT_FALSE(reader.error().empty());
+}
+
 ////////////////////////////////////// brute force solver //////////////////////////////////////
 
 bool canBeSolvedIn1s(const MovesArray& moves) {
@@ -619,6 +1110,318 @@ TEST(SolverTests, SemiSexyMoveSoltution) {
     ASSERT_STREQ(toString(solution).c_str(), "R U\' R\'");
 }
 
+// small patterns keep generation under a second
+const PatternDatabases& testPatternDatabases() {
+    static const PatternDatabases databases = [] {
+        PatternDatabases result;
+        std::string error;
+        EXPECT_TRUE(result.generate(defaultPatterns(3), error)) << error;
+        return result;
+    }();
+    return databases;
+}
+
+TEST(SolverTests, PatternDatabasesAreAdmissible) {
+    const PatternDatabases& databases = testPatternDatabases();
+    ASSERT_EQ(databases.databases().size(), 5 * 8) << "3-sticker patterns cover 24 stickers";
+    EXPECT_EQ(databases.databases().front().numEntries(), 24 * 23 * 22);
+    EXPECT_EQ(databases.heuristic(CubeState()), 0);
+
+    std::mt19937 rng(42);
+    uint8_t maxHeuristic = 0;
+    for (int i = 0; i < 200; ++i) {
+        CubeState state;
+        const uint8_t length = 1 + rng() % kMaxScrambleLength;
+        for (uint8_t j = 0; j < length; ++j)
+            state.applyScrambleMove(rng() % kNumAllQtmMoves);
+        const uint8_t h = databases.heuristic(state);
+        EXPECT_LE(h, length);
+        maxHeuristic = std::max(maxHeuristic, h);
+    }
+    EXPECT_GT(maxHeuristic, 1);
+}
+
+// @returns distances of all states within @param depth moves of @param start, by a BFS
+static std::unordered_map<CubeState, uint8_t> statesWithin(const CubeState& start, uint8_t depth) {
+    std::unordered_map<CubeState, uint8_t> result{{start, 0}};
+    std::vector<CubeState> frontier{start};
+    for (uint8_t distance = 1; distance <= depth; ++distance) {
+        std::vector<CubeState> next;
+        for (const CubeState& state: frontier) {
+            for (uint8_t m = 0; m < kNumAllQtmMoves; ++m) {
+                CubeState moved = state;
+                moved.applyScrambleMove(m);
+                if (result.emplace(moved, distance).second)
+                    next.push_back(moved);
+            }
+        }
+        frontier.swap(next);
+    }
+    return result;
+}
+
+TEST(SolverTests, PatternDatabasesNeverExceedDistance) {
+    const PatternDatabases& databases = testPatternDatabases();
+    const auto nearSolved = statesWithin(CubeState(), 3);
+    for (const auto& [state, distance]: nearSolved)
+        ASSERT_LE(databases.heuristic(state), distance) << state.toString();
+
+    // random states up to 6 moves away: the exact distance is the shortest way to nearSolved
+    std::mt19937 rng(11);
+    for (int i = 0; i < 20; ++i) {
+        CubeState state;
+        const uint8_t length = 4 + rng() % 3;
+        for (uint8_t j = 0; j < length; ++j)
+            state.applyScrambleMove(rng() % kNumAllQtmMoves);
+        uint8_t distance = length;
+        for (const auto& [near, toNear]: statesWithin(state, 3)) {
+            const auto itr = nearSolved.find(near);
+            if (nearSolved.end() != itr)
+                distance = std::min<uint8_t>(distance, toNear + itr->second);
+        }
+        EXPECT_LE(databases.heuristic(state), distance) << state.toString();
+    }
+}
+
+TEST(SolverTests, PatternDatabasesSaveAndLoad) {
+    const std::string dir = "/tmp/commfinder_pdb_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    ASSERT_TRUE(testPatternDatabases().save(dir));
+
+    PatternDatabases loaded;
+    std::string error;
+    ASSERT_TRUE(loaded.load(dir, error, true)) << error;
+    ASSERT_EQ(loaded.databases().size(), testPatternDatabases().databases().size());
+    std::mt19937 rng(7);
+    for (int i = 0; i < 100; ++i) {
+        CubeState state;
+        for (uint8_t j = 0; j < 6; ++j)
+            state.applyScrambleMove(rng() % kNumAllQtmMoves);
+        EXPECT_EQ(loaded.heuristic(state), testPatternDatabases().heuristic(state));
+    }
+
+    std::filesystem::resize_file(dir + "/corners0.pdb", 100);
+    EXPECT_FALSE(loaded.load(dir, error));
+    EXPECT_NE(error.find("corners0.pdb"), std::string::npos);
+    std::filesystem::remove_all(dir);
+    EXPECT_FALSE(loaded.load(dir, error));
+}
+
+TEST(SolverTests, OversizedPatternDatabasesAreRejected) {
+    PatternDatabases databases;
+    std::string error;
+    // ranks of 8 stickers don't fit in 32 bits
+    EXPECT_FALSE(databases.generate(defaultPatterns(kMaxPatternStickers + 1), error));
+    EXPECT_NE(error.find("corners0"), std::string::npos) << error;
+    // 10000 tables of 0.86 GB don't fit in any memory
+    std::vector<Pattern> patterns(10000, defaultPatterns(kMaxPatternStickers).front());
+    EXPECT_FALSE(databases.generate(patterns, error));
+    EXPECT_NE(error.find("MB of memory"), std::string::npos) << error;
+    EXPECT_TRUE(databases.databases().empty());
+}
+
+TEST(SolverTests, IdaStarFindsOptimalSolutions) {
+    for (const char* scramble: {"R", "R U R'", "R U R' U'", "r U2 M' F B"}) {
+        CubeState state;
+        state.applyStringScramble(scramble);
+        BruteForceSolver plain(state);
+        plain.setStrategy(SolverStrategy::IdaStar);
+        const MovesArray plainSolution = plain.solve(5);
+        BruteForceSolver pruned(state);
+        pruned.setStrategy(SolverStrategy::IdaStar);
+        pruned.setPatternDatabases(&testPatternDatabases());
+        const MovesArray solution = pruned.solve(5);
+
+        ASSERT_NE(kNoMove, solution.front()) << scramble;
+        EXPECT_EQ(numMoves(solution), numMoves(plainSolution)) << scramble;
+        EXPECT_LE(pruned.numVisitedStates(), plain.numVisitedStates()) << scramble;
+        state.applyScramble(solution);
+        EXPECT_TRUE(state.isSolved()) << scramble;
+    }
+
+    CubeState state;
+    state.applyStringScramble("R U R'");
+    BruteForceSolver solver(state);
+    solver.setStrategy(SolverStrategy::IdaStar);
+    solver.setPatternDatabases(&testPatternDatabases());
+    EXPECT_EQ(toString(solver.solve()), "R U' R'");
+    EXPECT_EQ(kNoMove, solver.solve(2).front());
+}
+
+TEST(SolverTests, MeetInTheMiddleFindsAllOptimalSolutions) {
+    for (const char* scramble: {"R", "R U R'", "R U R' U'", "r U2 M' F B"}) {
+        CubeState state;
+        state.applyStringScramble(scramble);
+        BruteForceSolver ida(state);
+        ida.setStrategy(SolverStrategy::IdaStar);
+        const MoveSequence optimal = ida.solveSequence(5);
+
+        // 50 entries keep only 1-move states near solved, the rest is searched forward
+        for (size_t maxEntries: {size_t(50), kDefaultMaxFrontierEntries}) {
+            BruteForceSolver solver(state);
+            solver.setStrategy(SolverStrategy::MeetInTheMiddle);
+            solver.setMaxFrontierEntries(maxEntries);
+            solver.setPatternDatabases(&testPatternDatabases());
+            EXPECT_EQ(solver.solveSequence(5).size(), optimal.size()) << scramble;
+
+            const std::vector<MoveSequence> all = solver.solveAll(5);
+            EXPECT_NE(std::find(all.begin(), all.end(), optimal), all.end()) << scramble;
+            std::set<MoveSequence> unique(all.begin(), all.end());
+            EXPECT_EQ(unique.size(), all.size()) << scramble;
+            for (const auto& solution: all) {
+                EXPECT_EQ(solution.size(), optimal.size());
+                CubeState solved = state;
+                for (uint8_t m: solution)
+                    solved.applyScrambleMove(m);
+                EXPECT_TRUE(solved.isSolved()) << scramble << ": " << toString(solution);
+            }
+        }
+    }
+
+    CubeState state;
+    state.applyStringScramble("R U R' U'");
+    BruteForceSolver solver(state);
+    solver.setStrategy(SolverStrategy::MeetInTheMiddle);
+    EXPECT_TRUE(solver.solveAll(3).empty());
+    const std::vector<MoveSequence> all = solver.solveAll(4);
+    ASSERT_EQ(all.size(), 1);
+    EXPECT_EQ(toString(all.front()), "U R U' R'");
+}
+
+TEST(SolverTests, ParallelSolversFindSameSolutions) {
+    for (const char* scramble: {"R", "R U R' U'", "r U2 M' F B"}) {
+        CubeState state;
+        state.applyStringScramble(scramble);
+        for (auto strategy: {SolverStrategy::BreadthSweep, SolverStrategy::IdaStar}) {
+            if (SolverStrategy::BreadthSweep == strategy && numMoves(stringToMoves(scramble)) > 4)
+                continue; // too slow
+            BruteForceSolver sequential(state);
+            sequential.setStrategy(strategy);
+            sequential.setPatternDatabases(&testPatternDatabases());
+            BruteForceSolver parallel(state);
+            parallel.setStrategy(strategy);
+            parallel.setPatternDatabases(&testPatternDatabases());
+            parallel.setNumThreads(4);
+            EXPECT_EQ(toString(parallel.solveSequence(5)), toString(sequential.solveSequence(5)))
+                << scramble;
+        }
+    }
+
+    CubeState state;
+    state.applyStringScramble("R U R' U'");
+    BruteForceSolver solver(state);
+    solver.setStrategy(SolverStrategy::IdaStar);
+    solver.setNumThreads(3);
+    EXPECT_TRUE(solver.solveSequence(3).empty());
+}
+
+TEST(SolverTests, TranspositionTableKeepsSolutions) {
+    for (const char* scramble: {"R U R' U'", "r U2 M' F B", "R L U D"}) {
+        CubeState state;
+        state.applyStringScramble(scramble);
+        BruteForceSolver plain(state);
+        plain.setStrategy(SolverStrategy::IdaStar);
+        plain.setTranspositionTableSize(0);
+        BruteForceSolver withTable(state);
+        withTable.setStrategy(SolverStrategy::IdaStar);
+        withTable.setTranspositionTableSize(1 << 16);
+        // a tiny table is overwritten all the time, it must stay correct
+        BruteForceSolver tinyTable(state);
+        tinyTable.setStrategy(SolverStrategy::IdaStar);
+        tinyTable.setTranspositionTableSize(3);
+        const std::string solution = toString(plain.solveSequence(5));
+        EXPECT_EQ(toString(withTable.solveSequence(5)), solution) << scramble;
+        EXPECT_EQ(toString(tinyTable.solveSequence(5)), solution) << scramble;
+        EXPECT_LE(withTable.numVisitedStates(), plain.numVisitedStates()) << scramble;
+    }
+}
+
+TEST(SolverTests, AllowedMovesRestrictSolutions) {
+    MoveSet moves;
+    ASSERT_TRUE(stringToMoveSet("<R, U>", moves));
+    CubeState state;
+    state.applyStringScramble("R U R' U'");
+    for (auto strategy: {SolverStrategy::BreadthSweep, SolverStrategy::IdaStar
+                         , SolverStrategy::MeetInTheMiddle}) {
+        for (unsigned numThreads: {1u, 3u}) {
+            BruteForceSolver solver(state);
+            solver.setStrategy(strategy);
+            solver.setPatternDatabases(&testPatternDatabases());
+            solver.setNumThreads(numThreads);
+            solver.setAllowedMoves(moves);
+            const MoveSequence solution = solver.solveSequence(5);
+            ASSERT_EQ(solution.size(), 4) << int(strategy);
+            CubeState solved = state;
+            for (uint8_t m: solution) {
+                EXPECT_TRUE(moves[m]) << toString(solution);
+                solved.applyScrambleMove(m);
+            }
+            EXPECT_TRUE(solved.isSolved()) << toString(solution);
+        }
+    }
+
+    // U quarter turns are needed
+    ASSERT_TRUE(stringToMoveSet("R,U2", moves));
+    for (auto strategy: {SolverStrategy::BreadthSweep, SolverStrategy::IdaStar
+                         , SolverStrategy::MeetInTheMiddle}) {
+        BruteForceSolver solver(state);
+        solver.setStrategy(strategy);
+        solver.setAllowedMoves(moves);
+        EXPECT_TRUE(solver.solveSequence(5).empty()) << int(strategy);
+    }
+}
+
+TEST(SolverTests, BatchSolverAnnotatesUniqueStates) {
+    BatchSolver solver(&testPatternDatabases());
+    solver.setNumThreads(3);
+    solver.setMaxSolutionLength(5);
+    std::istringstream in("search started\n"
+                          "c: [R, U]\n"
+                          "c: [R, U] (inert)\n"
+                          "c: [U, R]\n"
+                          "c: [R, L]\n");
+    const std::string input = in.str();
+    std::ostringstream out;
+    EXPECT_EQ(annotateResults(in, out, solver, 100).numResults, 4);
+    const std::string expected = "search started\n"
+                                 "c: [R, U] (optimal 4)\n"
+                                 "c: [R, U] (inert) (optimal 4)\n"
+                                 "c: [U, R] (optimal 4)\n"
+                                 "c: [R, L] (optimal 0)\n";
+    EXPECT_EQ(out.str(), expected);
+    EXPECT_EQ(solver.numStates(), 0) << "cleared after the chunk";
+
+    // chunks of 2 lines: same output
+    std::istringstream chunkedIn(input);
+    std::ostringstream chunkedOut;
+    EXPECT_EQ(annotateResults(chunkedIn, chunkedOut, solver, 2).numResults, 4);
+    EXPECT_EQ(chunkedOut.str(), expected);
+
+    std::istringstream longIn("c: [r, U R U']\n");
+    std::ostringstream longOut;
+    solver.setMaxSolutionLength(4);
+    const AnnotationCounts counts = annotateResults(longIn, longOut, solver);
+    EXPECT_EQ(counts.numNotFound, 1);
+    EXPECT_EQ(longOut.str(), "c: [r, U R U'] (not found within 4)\n");
+
+    // [R, U] twice; [R, L] is solved
+    solver.setMaxSolutionLength(5);
+    for (const char* scramble: {"R U R' U'", "R U R' U'", "U R U' R'", "R L R' L'"})
+        solver.add(CubeState().applyStringScramble(scramble));
+    ASSERT_EQ(solver.numStates(), 3);
+
+    CubeState state;
+    state.applyStringScramble("R U R' U' r");
+    const size_t id = solver.add(state);
+    EXPECT_EQ(solver.add(state), id);
+    solver.setMaxSolutionLength(4);
+    solver.solve();
+    EXPECT_FALSE(solver.isSolved(id));
+    EXPECT_TRUE(solver.isSolved(0));
+    EXPECT_EQ(solver.add(CubeState().applyStringScramble("R U R' U'")), 0);
+}
+
 TEST(SolverTests, CornerTwist) {
     CubeState state;
     ASSERT_FALSE(state.cornersTwistedAndSolved());
@@ -733,3 +1536,402 @@ TEST(CommFinder, WrittenAfewComms) {
     auto strings = getFileContents(std::string(kTmpCommfinderPath), false);
     ASSERT_GT(strings.size(), 0);
 }
+
+// @returns sorted lines of the file at @param path
+static std::vector<std::string> sortedLines(std::string_view path) {
+    std::vector<std::string> lines;
+    std::istringstream stream(getFileContents(path, false));
+    for (std::string line; std::getline(stream, line);)
+        lines.push_back(line);
+    std::sort(lines.begin(), lines.end());
+    return lines;
+}
+
+// runs 2-move search in @param mode and expects same results as incremental search
+static void expectSameCommsAsIncremental(SearchMode mode, bool useSymmetry = false
+                                         , unsigned numThreads = 1) {
+    // allSolved is on, so [A, B] with B parallel to A (e.g. [R, L]) are compared as well
+    const SearchCriteria criteriaAll(true, CenterSafety::SolvedCenterSafe);
+    CommutatorFinder cf(2, criteriaAll, kTmpCommfinderPath);
+    uint64_t numIncremental = cf.find();
+    auto incremental = sortedLines(kTmpCommfinderPath);
+    cf.setSearchMode(mode);
+    cf.setUseSymmetry(useSymmetry);
+    cf.setNumThreads(numThreads);
+    uint64_t numOther = cf.find();
+    auto other = sortedLines(kTmpCommfinderPath);
+    EXPECT_EQ(numIncremental, numOther);
+    ASSERT_EQ(incremental.size(), numIncremental);
+    EXPECT_EQ(incremental, other);
+}
+
+TEST(CommFinder, DepthFirstFindsSameComms) {
+    expectSameCommsAsIncremental(SearchMode::DepthFirst);
+}
+
+TEST(CommFinder, PartBFirstFindsSameComms) {
+    expectSameCommsAsIncremental(SearchMode::PartBFirst);
+}
+
+TEST(CommFinder, SymmetryFindsSameComms) {
+    for (auto mode: {SearchMode::Incremental, SearchMode::DepthFirst, SearchMode::PartBFirst})
+        expectSameCommsAsIncremental(mode, true);
+}
+
+TEST(CommFinder, ShardsFindSameComms) {
+    const SearchCriteria criteriaAll(true, CenterSafety::SolvedCenterSafe);
+    CommutatorFinder cf(2, criteriaAll, kTmpCommfinderPath);
+    uint64_t numIncremental = cf.find();
+    auto incremental = sortedLines(kTmpCommfinderPath);
+
+    constexpr unsigned kNumShards = 3;
+    uint64_t numSharded = 0;
+    std::vector<std::string> sharded;
+    for (unsigned i = 0; i < kNumShards; ++i) {
+        cf.setShard(i, kNumShards);
+        numSharded += cf.find();
+        const std::string shardPath = shardFilePath(kTmpCommfinderPath, i, kNumShards);
+        auto lines = sortedLines(shardPath);
+        EXPECT_GT(lines.size(), 0) << shardPath;
+        sharded.insert(sharded.end(), lines.begin(), lines.end());
+        std::remove(shardPath.c_str());
+    }
+    std::sort(sharded.begin(), sharded.end());
+    EXPECT_EQ(numIncremental, numSharded);
+    EXPECT_EQ(incremental, sharded);
+}
+
+// results of all files of a search with output to @param outputPath, sorted
+static std::vector<std::string> sortedResults(std::string_view outputPath, uint8_t maxMovesPartB) {
+    if ('/' != outputPath.back())
+        return sortedLines(outputPath);
+    std::vector<std::string> results;
+    for (size_t i = 0; i < size_t(CaseType::caseTypeEnd); ++i) {
+        for (uint8_t partBsize = 1; partBsize <= maxMovesPartB; ++partBsize) {
+            const auto lines = sortedLines(resultsFilePath(outputPath, CaseType(i), partBsize));
+            results.insert(results.end(), lines.begin(), lines.end());
+        }
+    }
+    std::sort(results.begin(), results.end());
+    return results;
+}
+
+TEST(CommFinder, MergedShardsMatchSingleRun) {
+    const std::string dir = "/tmp/cf_test_suite_dir/";
+    std::filesystem::create_directories(dir);
+    const SearchCriteria criteriaAll(true, CenterSafety::SolvedCenterSafe);
+    constexpr uint8_t kMaxMoves = 2;
+    constexpr unsigned kNumShards = 3;
+    for (const std::string& path: {std::string(kTmpCommfinderPath), dir}) {
+        CommutatorFinder single(kMaxMoves, criteriaAll, path);
+        const uint64_t numExpected = single.find();
+        const auto expected = sortedResults(path, kMaxMoves);
+
+        CommutatorFinder cf(kMaxMoves, criteriaAll, path);
+        for (unsigned i = 0; i < kNumShards; ++i) {
+            cf.setShard(i, kNumShards);
+            cf.find();
+        }
+        // an unfinished shard fails the merge and keeps all inputs
+        const std::string checkpoint = checkpointFilePath(path, 1, kNumShards);
+        const std::string finished = getFileContents(checkpoint, false);
+        std::remove(checkpoint.c_str());
+        EXPECT_EQ(mergeShards(path, kMaxMoves, kNumShards, false, false), -1) << path;
+        EXPECT_EQ(sortedResults(path, kMaxMoves), expected) << path;
+        saveToFile(checkpoint, finished, false);
+
+        EXPECT_EQ(mergeShards(path, kMaxMoves, kNumShards, false, false), int64_t(numExpected)) << path;
+        EXPECT_EQ(sortedResults(path, kMaxMoves), expected) << path;
+        EXPECT_TRUE(std::filesystem::exists(checkpoint)) << "inputs are kept by default";
+
+        EXPECT_EQ(mergeShards(path, kMaxMoves, kNumShards, false, true), int64_t(numExpected)) << path;
+        EXPECT_EQ(sortedResults(path, kMaxMoves), expected) << path;
+        EXPECT_FALSE(std::filesystem::exists(checkpoint));
+        EXPECT_FALSE(std::filesystem::exists(shardFilePath(
+                ('/' == path.back()) ? resultsFilePath(path, CaseType::c3cycles, 1) : path
+                , 0, kNumShards)));
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST(CommFinder, ParallelFindsSameComms) {
+    expectSameCommsAsIncremental(SearchMode::Incremental, false, 4);
+    expectSameCommsAsIncremental(SearchMode::Incremental, true, 3);
+}
+
+TEST(CommFinder, BinaryOutputExportsToSameText) {
+    const SearchCriteria criteriaAll(true, CenterSafety::SolvedCenterSafe);
+    CommutatorFinder cf(3, criteriaAll, kTmpCommfinderPath);
+    const uint64_t numResults = cf.find();
+    const std::string text = getFileContents(kTmpCommfinderPath, false);
+
+    const std::string binaryPath = std::string(kTmpCommfinderPath) + ".bin";
+    CommutatorFinder binaryCf(3, criteriaAll, binaryPath);
+    binaryCf.setBinaryOutput(true);
+    EXPECT_EQ(binaryCf.find(), numResults);
+    ResultReader reader(binaryPath);
+    std::string exported;
+    for (ResultRecord record; reader.next(record);)
+        exported += resultToText(record);
+    EXPECT_TRUE(reader.error().empty()) << reader.error();
+    EXPECT_EQ(exported, text);
+}
+
+TEST(CommFinder, FindInertMove) {
+    // @returns state of [@param a, @param b] replayed move by move
+    auto replay = [](const std::string& a, const std::string& b) {
+        return CubeState().applyStringScramble(
+                commutatorToString(stringToMove(a), stringToMoves(b), false));
+    };
+    auto inertMove = [](const std::string& a, const std::string& b, bool compareCenters) {
+        const CubeState state = commutator(CubeState::moveState(stringToMove(a))
+                                           , CubeState().applyScramble(stringToMoves(b)));
+        return findInertMove(stringToMove(a), stringToMoves(b), state, compareCenters);
+    };
+    EXPECT_EQ(replay("L", "E' R M E"), replay("L", "E' R E"));
+    EXPECT_EQ(inertMove("L", "E' R M E", true), 2);
+    EXPECT_EQ(inertMove("R", "U", true), kNoMove);
+    EXPECT_EQ(inertMove("R", "U R' U'", true), kNoMove);
+    // README example: M only moves centers here
+    EXPECT_EQ(inertMove("L", "U2 M U R U", false), 1);
+}
+
+TEST(CommFinder, InertMovesAreTaggedOrDropped) {
+    const SearchCriteria criteriaAll(true, CenterSafety::SolvedCenterSafe);
+    CommutatorFinder cf(3, criteriaAll, kTmpCommfinderPath);
+    cf.find();
+    const auto plain = sortedLines(kTmpCommfinderPath);
+    cf.setInertMoves(InertMoves::Tag);
+    cf.find();
+    std::vector<std::string> untagged, kept;
+    for (auto line: sortedLines(kTmpCommfinderPath)) {
+        const size_t tag = line.find(kInertMoveTag);
+        if (std::string::npos == tag)
+            kept.push_back(line);
+        else
+            line.resize(tag);
+        untagged.push_back(line);
+    }
+    std::sort(untagged.begin(), untagged.end());
+    EXPECT_EQ(untagged, plain);
+    EXPECT_GT(kept.size(), 0);
+    EXPECT_LT(kept.size(), plain.size());
+    cf.setInertMoves(InertMoves::Drop);
+    EXPECT_EQ(cf.find(), kept.size());
+    EXPECT_EQ(sortedLines(kTmpCommfinderPath), kept);
+}
+
+// tests of every SearchMode
+class SearchModeTest : public ::testing::TestWithParam<SearchMode> {};
+
+INSTANTIATE_TEST_SUITE_P(CommFinder, SearchModeTest, ::testing::Values(
+        SearchMode::Incremental, SearchMode::DepthFirst, SearchMode::PartBFirst)
+        , [](const ::testing::TestParamInfo<SearchMode>& info) {
+    return SearchMode::Incremental == info.param ? "Incremental"
+            : SearchMode::DepthFirst == info.param ? "DepthFirst" : "PartBFirst";
+});
+
+// expects @param numFound results of the last search and its output file to hold @param expected
+static void expectResults(uint64_t numFound, const std::vector<std::string>& expected) {
+    EXPECT_EQ(numFound, expected.size());
+    EXPECT_EQ(sortedLines(kTmpCommfinderPath), expected);
+}
+
+// runs a 3-move search with @param criteria, then the same search in @param mode after
+// @param configure and expects the results of the first one that @param keep accepts.
+// Progress of the filtered search must end at exactly the number of its candidates
+template <class Configure, class Keep>
+static void expectFilteredResults(SearchMode mode, const SearchCriteria& criteria
+                                  , Configure configure, Keep keep) {
+    CommutatorFinder cf(3, criteria, kTmpCommfinderPath);
+    cf.find();
+    std::vector<std::string> expected;
+    for (const auto& line: sortedLines(kTmpCommfinderPath))
+        if (keep(line))
+            expected.push_back(line);
+    ASSERT_GT(expected.size(), 0);
+    cf.setSearchMode(mode);
+    configure(cf);
+    expectResults(cf.find(), expected);
+    EXPECT_EQ(cf.numDoneCandidates(), cf.numCandidates());
+}
+
+// @returns alg of result @param line, e.g. "[R, U]"
+static std::string resultAlg(const std::string& line) {
+    const size_t begin = line.find('[');
+    return line.substr(begin, line.find(']') + 1 - begin);
+}
+
+TEST_P(SearchModeTest, ResumedSearchFindsSameComms) {
+    const SearchCriteria criteriaAll(true, CenterSafety::SolvedCenterSafe);
+    CommutatorFinder cf(3, criteriaAll, kTmpCommfinderPath);
+    cf.setSearchMode(GetParam());
+    cf.setNumThreads(SearchMode::DepthFirst == GetParam() ? 3 : 1);
+    cf.find();
+    const auto expected = sortedLines(kTmpCommfinderPath);
+
+    // stop several times, resume each time. Runs get longer, so slow machines finish as well
+    cf.setCheckpointInterval(0s);
+    const std::string checkpoint = checkpointFilePath(kTmpCommfinderPath);
+    uint64_t numFound = 0;
+    for (int i = 0; i < 100; ++i) {
+        std::thread stopper([i] {
+            std::this_thread::sleep_for(20ms * (1 << std::min(i / 10, 6)));
+            CommutatorFinder::requestStop();
+        });
+        numFound = cf.find();
+        stopper.join();
+        EXPECT_LE(numFound, expected.size());
+        if (!std::filesystem::exists(checkpoint))
+            break; // finished
+        // written after the last checkpoint => dropped on resume
+        saveToFile(kTmpCommfinderPath, "partially written result", true);
+        cf.setResume(true);
+    }
+    EXPECT_FALSE(std::filesystem::exists(checkpoint)) << "finished search removes checkpoint";
+    expectResults(numFound, expected);
+}
+
+// corner cases with only outer moves
+TEST_P(SearchModeTest, RelevantLayersOnlyFiltersAlgs) {
+    SearchCriteria corners(false);
+    for (auto ct: {CaseType::c3cycles, CaseType::c22swaps, CaseType::corner3Twists})
+        corners.set(ct, true);
+    expectFilteredResults(GetParam(), corners, [](CommutatorFinder& cf) {
+        cf.setRelevantLayersOnly(true);
+    }, [](const std::string& line) {
+        return resultAlg(line).find_first_of("lurdfbMES") == std::string::npos;
+    });
+}
+
+// outer L moves pieces of every orbit, so no case excludes it: only allowed moves can. Corner
+// cases of <R, U, D, r, M> keep <R, U, D> algs, the first partB of each partA is filtered too
+TEST_P(SearchModeTest, RelevantLayersOnlyFiltersAllowedMoves) {
+    MoveSet moves;
+    ASSERT_TRUE(stringToMoveSet("R,U,D,r,M", moves));
+    SearchCriteria corners(false);
+    for (auto ct: {CaseType::c3cycles, CaseType::c22swaps, CaseType::corner3Twists})
+        corners.set(ct, true);
+    expectFilteredResults(GetParam(), corners, [&moves](CommutatorFinder& cf) {
+        cf.setAllowedMoves(moves);
+        cf.setRelevantLayersOnly(true);
+    }, [](const std::string& line) {
+        return resultAlg(line).find_first_of("LFBlurdfbMES") == std::string::npos;
+    });
+}
+
+// all cases with <R, U, r> moves only
+TEST_P(SearchModeTest, AllowedMovesFilterAlgs) {
+    MoveSet moves;
+    ASSERT_TRUE(stringToMoveSet("R,U,r", moves));
+    const SearchCriteria criteriaAll(true, CenterSafety::SolvedCenterSafe);
+    expectFilteredResults(GetParam(), criteriaAll, [&moves](CommutatorFinder& cf) {
+        cf.setUseSymmetry(true); // not used with restricted moves
+        cf.setAllowedMoves(moves);
+    }, [](const std::string& line) {
+        return resultAlg(line).find_first_of("LDFBludfbMES") == std::string::npos;
+    });
+}
+
+////////////////////////////////////// resultindex //////////////////////////////
+TEST(ResultIndex, CanonicalCycles) {
+    EXPECT_EQ(canonicalCycles("UR-UF-UB."), "BU-RU-FU.");
+    EXPECT_EQ(canonicalCycles("UL-UR.DF-DB."), canonicalCycles("DB-DF.UR-UL."));
+    // same pieces in other orientations
+    EXPECT_EQ(canonicalCycles("UR-UF-UB."), canonicalCycles("FU-BU-RU."));
+    EXPECT_EQ(canonicalCycles("UFR-URB-UBL."), canonicalCycles("RUF-BUR-LUB."));
+    EXPECT_EQ(canonicalCycles("UFR-URB-UBL."), canonicalCycles("BLU-FRU-RBU."));
+    EXPECT_NE(canonicalCycles("Ufr-Urb-Ubl."), canonicalCycles("Ruf-Bur-Lub."));
+    EXPECT_EQ(caseTypeFromString(toString(CaseType::c22swaps)), CaseType::c22swaps);
+    EXPECT_EQ(caseTypeFromString("nothing"), CaseType::caseTypeEnd);
+}
+
+TEST(ResultIndex, IndexHasAllResultsShortestFirst) {
+    const SearchCriteria criteriaAll(true, CenterSafety::SolvedCenterSafe);
+    CommutatorFinder cf(2, criteriaAll, kTmpCommfinderPath);
+    const uint64_t numResults = cf.find();
+    const std::string indexPath = std::string(kTmpCommfinderPath) + ".idx";
+    std::string error;
+    ASSERT_EQ(buildResultIndex({std::string(kTmpCommfinderPath)}, indexPath, error), int64_t(numResults)) << error;
+
+    const ResultIndex index(indexPath);
+    ASSERT_TRUE(index.error().empty()) << index.error();
+    std::vector<std::string> lines;
+    for (size_t key = 0; key < index.numKeys(); ++key) {
+        for (size_t i = 0; i < index.numRecords(key); ++i) {
+            if (i > 0) {
+                EXPECT_LE(index.partBsize(key, i - 1), index.partBsize(key, i));
+            }
+            const ResultRecord record = index.record(key, i);
+            EXPECT_EQ(record.caseType, index.caseType(key));
+            EXPECT_EQ(canonicalCycles(resultCycles(record)), index.cycles(key));
+            std::string line = resultToText(record);
+            line.pop_back();
+            const std::string text = index.text(key, i);
+            EXPECT_EQ(text.substr(index.cycles(key).size())
+                      , line.substr(resultCycles(record).size()) + "\n");
+            lines.push_back(line);
+        }
+    }
+    std::sort(lines.begin(), lines.end());
+    EXPECT_EQ(lines, sortedLines(kTmpCommfinderPath));
+
+    // every key is found by its cycles
+    for (size_t key = 0; key < index.numKeys(); ++key) {
+        const auto [first, last] = index.findKeys(index.caseType(key), index.cycles(key));
+        EXPECT_LE(first, key);
+        EXPECT_GT(last, key);
+    }
+}
+
+TEST(ResultIndex, PieceIsFoundByAnySticker) {
+    EXPECT_EQ(pieceStickers("UFR"), StringVec({"UFR", "RUF", "FRU"}));
+    EXPECT_EQ(pieceStickers("FU"), StringVec({"FU", "UF"}));
+    EXPECT_EQ(pieceStickers("Ufr"), StringVec({"Ufr"}));
+    EXPECT_TRUE(pieceStickers("UFL").empty());
+
+    SearchCriteria corners(false);
+    corners.set(CaseType::c3cycles, true);
+    CommutatorFinder cf(3, corners, kTmpCommfinderPath);
+    cf.find();
+    const std::string indexPath = std::string(kTmpCommfinderPath) + ".idx";
+    std::string error;
+    ASSERT_GT(buildResultIndex({std::string(kTmpCommfinderPath)}, indexPath, error), 0) << error;
+    const ResultIndex index(indexPath);
+    ASSERT_TRUE(index.error().empty()) << index.error();
+
+    // keys with the corner UFR, found by each of its stickers
+    std::vector<std::vector<size_t>> found;
+    for (const std::string sticker: {"UFR", "RUF", "FRU"}) {
+        found.emplace_back();
+        for (size_t key = 0; key < index.numKeys(); ++key)
+            if (cyclesHavePiece(index.cycles(key), sticker))
+                found.back().push_back(key);
+    }
+    EXPECT_GT(found[0].size(), 0);
+    EXPECT_LT(found[0].size(), index.numKeys());
+    EXPECT_EQ(found[0], found[1]);
+    EXPECT_EQ(found[0], found[2]);
+
+    // a key of a case is found by its cycles in any orientation
+    std::string cycle(index.cycles(found[0][0]));
+    cycle.pop_back(); // 3-cycles have one cycle
+    std::string twisted;
+    for (const auto& sticker: splitString(cycle, '-'))
+        twisted += pieceStickers(sticker)[1] + "-";
+    twisted.back() = '.';
+    EXPECT_EQ(canonicalCycles(twisted), index.cycles(found[0][0]));
+}
+
+TEST(ResultIndex, OverflowingKeyFailsBuild) {
+    // cycles longer than IndexKey::cyclesSize holds
+    std::string cycles;
+    for (int i = 0; cycles.size() <= UINT16_MAX; ++i)
+        cycles += "X" + std::to_string(i) + "-";
+    cycles.back() = '.';
+    saveToFile(kTmpCommfinderPath, cycles + ": [L, U' R U]\n");
+    const std::string indexPath = std::string(kTmpCommfinderPath) + ".idx";
+    std::string error;
+    EXPECT_EQ(buildResultIndex({std::string(kTmpCommfinderPath)}, indexPath, error), -1);
+    EXPECT_FALSE(error.empty());
+}